@@ -7,6 +7,7 @@
 //
 //===----------------------------------------------------------------------===//
 
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
 #include "MCTargetDesc/Cpu0MCTargetDesc.h"
 #include "Cpu0RegisterInfo.h"
 #include "llvm/ADT/APInt.h"
@@ -59,6 +60,9 @@ class Cpu0AsmParser : public MCTargetAsmParser {
   MCSubtargetInfo &STI;
   MCAsmParser &Parser;
   Cpu0AssemblerOptions Options;
+  // Shared by the li/la expansions, so an immediate that is loaded again
+  // is found in the cache of Analyze instead of being searched again.
+  Cpu0AnalyzeImmediate AnalyzeImm;
 
 
 #define GET_ASSEMBLER_HEADER
@@ -309,50 +313,45 @@ void Cpu0AsmParser::expandInstruction(MCInst &Inst, SMLoc IDLoc,
     }
 }
 
+/// createLoadImm - Append the shortest sequence Cpu0AnalyzeImmediate finds
+/// to load Imm into Reg, the same sequence the compiler would emit.
+static void createLoadImm(unsigned Reg, int64_t Imm, SMLoc IDLoc,
+                          SmallVectorImpl<MCInst> &Instructions,
+                          Cpu0AnalyzeImmediate &AnalyzeImm) {
+  const Cpu0AnalyzeImmediate::InstSeq &Seq =
+    AnalyzeImm.Analyze((uint32_t)Imm, 32, false /* LastInstrIsADDiu */);
+
+  // The first instruction starts from $zero, the others from Reg. lui is
+  // the only one without a source register.
+  unsigned SrcReg = Cpu0::ZERO;
+  for (Cpu0AnalyzeImmediate::InstSeq::const_iterator Inst = Seq.begin();
+       Inst != Seq.end(); ++Inst) {
+    MCInst tmpInst;
+    tmpInst.setOpcode(Inst->Opc);
+    tmpInst.setLoc(IDLoc);
+    tmpInst.addOperand(MCOperand::CreateReg(Reg));
+    if (Inst->Opc != Cpu0::LUi)
+      tmpInst.addOperand(MCOperand::CreateReg(SrcReg));
+    // Only addiu takes a signed immediate.
+    int64_t ImmOpnd = Inst->ImmOpnd;
+    if (Inst->Opc == Cpu0::ADDiu)
+      ImmOpnd = SignExtend64<16>(ImmOpnd);
+    tmpInst.addOperand(MCOperand::CreateImm(ImmOpnd));
+    Instructions.push_back(tmpInst);
+    SrcReg = Reg;
+  }
+}
+
 void Cpu0AsmParser::expandLoadImm(MCInst &Inst, SMLoc IDLoc,
                                   SmallVectorImpl<MCInst> &Instructions){
-  MCInst tmpInst;
   const MCOperand &ImmOp = Inst.getOperand(1);
   assert(ImmOp.isImm() && "expected immediate operand kind");
   const MCOperand &RegOp = Inst.getOperand(0);
   assert(RegOp.isReg() && "expected register operand kind");
 
-  int ImmValue = ImmOp.getImm();
-  tmpInst.setLoc(IDLoc);
-  if ( 0 <= ImmValue && ImmValue <= 65535) {
-    // for 0 <= j <= 65535.
-    // li d,j => ori d,$zero,j
-    tmpInst.setOpcode(Cpu0::ORi);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(
-              MCOperand::CreateReg(Cpu0::ZERO));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue));
-    Instructions.push_back(tmpInst);
-  } else if ( ImmValue < 0 && ImmValue >= -32768) {
-    // for -32768 <= j < 0.
-    // li d,j => addiu d,$zero,j
-    tmpInst.setOpcode(Cpu0::ADDiu); //TODO:no ADDiu64 in td files?
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(
-              MCOperand::CreateReg(Cpu0::ZERO));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue));
-    Instructions.push_back(tmpInst);
-  } else {
-    // for any other value of j that is representable as a 32-bit integer.
-    // li d,j => lui d,hi16(j)
-    //           ori d,d,lo16(j)
-    tmpInst.setOpcode(Cpu0::LUi);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm((ImmValue & 0xffff0000) >> 16));
-    Instructions.push_back(tmpInst);
-    tmpInst.clear();
-    tmpInst.setOpcode(Cpu0::ORi);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue & 0xffff));
-    tmpInst.setLoc(IDLoc);
-    Instructions.push_back(tmpInst);
-  }
+  // li d,j => ori d,$zero,j, addiu d,$zero,j, lui d,hi16(j), ...
+  createLoadImm(RegOp.getReg(), ImmOp.getImm(), IDLoc, Instructions,
+                AnalyzeImm);
 }
 
 void Cpu0AsmParser::expandLoadAddressReg(MCInst &Inst, SMLoc IDLoc,
@@ -365,6 +364,7 @@ void Cpu0AsmParser::expandLoadAddressReg(MCInst &Inst, SMLoc IDLoc,
   const MCOperand &DstRegOp = Inst.getOperand(0);
   assert(DstRegOp.isReg() && "expected register operand kind");
   int ImmValue = ImmOp.getImm();
+  tmpInst.setLoc(IDLoc);
   if ( -32768 <= ImmValue && ImmValue <= 32767) {
     // for -32768 <= j < 32767.
     //la d,j(s) => addiu d,s,j
@@ -375,23 +375,16 @@ void Cpu0AsmParser::expandLoadAddressReg(MCInst &Inst, SMLoc IDLoc,
     Instructions.push_back(tmpInst);
   } else {
     // for any other value of j that is representable as a 32-bit integer.
-    // la d,j(s) => lui d,hi16(j)
-    //              ori d,d,lo16(j)
-    //              add d,d,s
-    tmpInst.setOpcode(Cpu0::LUi);
-    tmpInst.addOperand(MCOperand::CreateReg(DstRegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm((ImmValue & 0xffff0000) >> 16));
-    Instructions.push_back(tmpInst);
-    tmpInst.clear();
-    tmpInst.setOpcode(Cpu0::ORi);
-    tmpInst.addOperand(MCOperand::CreateReg(DstRegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateReg(DstRegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue & 0xffff));
-    Instructions.push_back(tmpInst);
-    tmpInst.clear();
+    // la d,j(s) => li t,j
+    //              add d,t,s
+    // t is d, or $at if d is also the base register s.
+    unsigned TmpReg = DstRegOp.getReg();
+    if (TmpReg == SrcRegOp.getReg())
+      TmpReg = Cpu0::AT;
+    createLoadImm(TmpReg, ImmValue, IDLoc, Instructions, AnalyzeImm);
     tmpInst.setOpcode(Cpu0::ADD);
     tmpInst.addOperand(MCOperand::CreateReg(DstRegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateReg(DstRegOp.getReg()));
+    tmpInst.addOperand(MCOperand::CreateReg(TmpReg));
     tmpInst.addOperand(MCOperand::CreateReg(SrcRegOp.getReg()));
     Instructions.push_back(tmpInst);
   }
@@ -399,36 +392,14 @@ void Cpu0AsmParser::expandLoadAddressReg(MCInst &Inst, SMLoc IDLoc,
 
 void Cpu0AsmParser::expandLoadAddressImm(MCInst &Inst, SMLoc IDLoc,
                                          SmallVectorImpl<MCInst> &Instructions){
-  MCInst tmpInst;
   const MCOperand &ImmOp = Inst.getOperand(1);
   assert(ImmOp.isImm() && "expected immediate operand kind");
   const MCOperand &RegOp = Inst.getOperand(0);
   assert(RegOp.isReg() && "expected register operand kind");
-  int ImmValue = ImmOp.getImm();
-  if ( -32768 <= ImmValue && ImmValue <= 32767) {
-    // for -32768 <= j < 32767.
-    //la d,j => addiu d,$zero,j
-    tmpInst.setOpcode(Cpu0::ADDiu);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(
-              MCOperand::CreateReg(Cpu0::ZERO));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue));
-    Instructions.push_back(tmpInst);
-  } else {
-    // for any other value of j that is representable as a 32-bit integer.
-    // la d,j => lui d,hi16(j)
-    //           ori d,d,lo16(j)
-    tmpInst.setOpcode(Cpu0::LUi);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm((ImmValue & 0xffff0000) >> 16));
-    Instructions.push_back(tmpInst);
-    tmpInst.clear();
-    tmpInst.setOpcode(Cpu0::ORi);
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateReg(RegOp.getReg()));
-    tmpInst.addOperand(MCOperand::CreateImm(ImmValue & 0xffff));
-    Instructions.push_back(tmpInst);
-  }
+
+  // la d,j => li d,j
+  createLoadImm(RegOp.getReg(), ImmOp.getImm(), IDLoc, Instructions,
+                AnalyzeImm);
 }
 
 bool Cpu0AsmParser::
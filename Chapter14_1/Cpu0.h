@@ -21,11 +21,14 @@
 namespace llvm {
   class Cpu0TargetMachine;
   class FunctionPass;
+  class ImmutablePass;
 
   FunctionPass *createCpu0ISelDag(Cpu0TargetMachine &TM);
   FunctionPass *createCpu0EmitGPRestorePass(Cpu0TargetMachine &TM);
   FunctionPass *createCpu0DelaySlotFillerPass(Cpu0TargetMachine &TM);
   FunctionPass *createCpu0DelJmpPass(Cpu0TargetMachine &TM);
+  FunctionPass *createCpu0OptimizeCmpPass(Cpu0TargetMachine &TM);
+  ImmutablePass *createCpu0TargetTransformInfoPass(const Cpu0TargetMachine *TM);
 
 } // end namespace llvm;
 
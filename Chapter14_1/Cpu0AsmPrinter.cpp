@@ -28,9 +28,11 @@
 #include "llvm/CodeGen/MachineConstantPool.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineInstr.h"
+#include "llvm/CodeGen/MachineJumpTableInfo.h"
 #include "llvm/CodeGen/MachineMemOperand.h"
 #include "llvm/MC/MCStreamer.h"
 #include "llvm/MC/MCAsmInfo.h"
+#include "llvm/MC/MCExpr.h"
 #include "llvm/MC/MCInst.h"
 #include "llvm/MC/MCSymbol.h"
 #include "llvm/Support/TargetRegistry.h"
@@ -53,8 +55,46 @@ void Cpu0AsmPrinter::EmitInstrWithMacroNoAT(const MachineInstr *MI) {
   OutStreamer.EmitRawText(StringRef("\t.set\tnomacro"));
 } // lbd document - mark - EmitInstrWithMacroNoAT
 
+/// computeJumpTableEntrySize - The jump tables follow the last basic block,
+/// so no entry is further from its table than the size of the function. The
+/// code is final here; only BEQ/BNE may still be relaxed by the assembler,
+/// which is charged at its long form.
+unsigned
+Cpu0AsmPrinter::computeJumpTableEntrySize(const MachineFunction &MF) const {
+  const Cpu0InstrInfo *TII =
+    static_cast<const Cpu0InstrInfo*>(TM.getInstrInfo());
+
+  // .cpload, emitted at the function start.
+  uint64_t Size = 12;
+  for (MachineFunction::const_iterator MBB = MF.begin(), E = MF.end();
+       MBB != E; ++MBB) {
+    Size += (1 << MBB->getAlignment()) - 1;
+    for (MachineBasicBlock::const_instr_iterator I = MBB->instr_begin(),
+         IE = MBB->instr_end(); I != IE; ++I) {
+      Size += TII->GetInstSizeInBytes(I);
+      if (I->getOpcode() == Cpu0::BEQ || I->getOpcode() == Cpu0::BNE)
+        Size += 8;
+    }
+  }
+
+  // An entry is also as far from its table as the tables before it, which
+  // are charged at 4-byte entries, after up to 3 bytes of alignment.
+  const MachineJumpTableInfo *MJTI = MF.getJumpTableInfo();
+  const std::vector<MachineJumpTableEntry> &JT = MJTI->getJumpTables();
+  Size += 3;
+  for (unsigned JTI = 0, e = JT.size(); JTI != e; ++JTI)
+    Size += 4 * JT[JTI].MBBs.size();
+
+  return Size <= 32768 ? 2 : 4;
+}
+
 bool Cpu0AsmPrinter::runOnMachineFunction(MachineFunction &MF) {
-  Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
+  Cpu0FunctionInfo *FI = MF.getInfo<Cpu0FunctionInfo>();
+  const MachineJumpTableInfo *MJTI = MF.getJumpTableInfo();
+  if (MJTI && !MJTI->isEmpty())
+    FI->setJumpTableEntrySize(computeJumpTableEntrySize(MF));
+
+  Cpu0FI = FI;
   AsmPrinter::runOnMachineFunction(MF);
   return true;
 }
@@ -95,6 +135,16 @@ void Cpu0AsmPrinter::EmitInstruction(const MachineInstr *MI) {
 
     break;
   }
+  case Cpu0::LoadJTEntry: {
+    MCInstLowering.LowerLoadJTEntry(MI, Cpu0FI->getJumpTableEntrySize(),
+                                    MCInsts);
+
+    for (SmallVector<MCInst, 4>::iterator I = MCInsts.begin();
+         I != MCInsts.end(); ++I)
+      OutStreamer.EmitInstruction(*I, getSubtargetInfo());
+
+    return;
+  }
   default:
     break;
   } // lbd document - mark - switch (Opc)
@@ -235,7 +285,7 @@ void Cpu0AsmPrinter::EmitFunctionBodyStart() {
   emitFrameDirective();
   bool EmitCPLoad = (MF->getTarget().getRelocationModel() == Reloc::PIC_) &&
     Cpu0FI->globalBaseRegSet() &&
-    Cpu0FI->globalBaseRegFixed();
+    Cpu0FI->globalBaseRegFixed() && Cpu0FI->usesGP();
   if (Cpu0NoCpload)
     EmitCPLoad = false;
 
@@ -267,6 +317,8 @@ void Cpu0AsmPrinter::EmitFunctionBodyStart() {
 /// EmitFunctionBodyEnd - Targets can override this to emit stuff after
 /// the last basic block in the function.
 void Cpu0AsmPrinter::EmitFunctionBodyEnd() {
+  emitJumpTables();
+
   // There are instruction for this macros, but they must
   // always be at the function end, and we can't emit and
   // break with BB logic.
@@ -279,6 +331,45 @@ void Cpu0AsmPrinter::EmitFunctionBodyEnd() {
   }
 }
 
+/// emitJumpTables - Emit the jump tables of the function after its last
+/// basic block, in the text section. Each entry is the distance of the case
+/// block from the start of its table, which the dispatch sequence built by
+/// Cpu0TargetLowering::lowerBR_JT adds back to the table address.
+void Cpu0AsmPrinter::emitJumpTables() {
+  const MachineJumpTableInfo *MJTI = MF->getJumpTableInfo();
+  if (!MJTI || MJTI->isEmpty())
+    return;
+
+  assert(MJTI->getEntryKind() == MachineJumpTableInfo::EK_Inline &&
+         "Cpu0 jump tables are emitted inline");
+  unsigned EntrySize = Cpu0FI->getJumpTableEntrySize();
+  const std::vector<MachineJumpTableEntry> &JT = MJTI->getJumpTables();
+
+  EmitAlignment(Log2_32(EntrySize));
+  for (unsigned JTI = 0, e = JT.size(); JTI != e; ++JTI) {
+    const std::vector<MachineBasicBlock*> &JTBBs = JT[JTI].MBBs;
+    if (JTBBs.empty())
+      continue;
+
+    MCSymbol *JTISymbol = GetJTISymbol(JTI);
+    OutStreamer.EmitLabel(JTISymbol);
+    const MCExpr *Base = MCSymbolRefExpr::Create(JTISymbol, OutContext);
+    for (unsigned i = 0, ie = JTBBs.size(); i != ie; ++i) {
+      const MCExpr *MBBExpr =
+        MCSymbolRefExpr::Create(JTBBs[i]->getSymbol(), OutContext);
+      OutStreamer.EmitValue(MCBinaryExpr::CreateSub(MBBExpr, Base,
+                                                    OutContext),
+                            EntrySize);
+    }
+  }
+
+  // An odd number of 2-byte entries leaves the section off a word boundary.
+  // Pad with zero bytes, as data, so the next function's code alignment
+  // only ever has whole nop words to fill.
+  if (EntrySize < 4)
+    OutStreamer.EmitValueToAlignment(4, 0);
+}
+
 //	.section .mdebug.abi32
 //	.previous
 void Cpu0AsmPrinter::EmitStartOfAsmFile(Module &M) {
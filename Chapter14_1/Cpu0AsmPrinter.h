@@ -31,6 +31,7 @@ class raw_ostream;
 class LLVM_LIBRARY_VISIBILITY Cpu0AsmPrinter : public AsmPrinter {
 
   void EmitInstrWithMacroNoAT(const MachineInstr *MI);
+  unsigned computeJumpTableEntrySize(const MachineFunction &MF) const;
 
 public:
 
@@ -54,6 +55,7 @@ public:
   void printSavedRegsBitmask(raw_ostream &O);
   void printHex32(unsigned int Value, raw_ostream &O);
   void emitFrameDirective();
+  void emitJumpTables();
   const char *getCurrentABIString() const;
   virtual void EmitFunctionEntryLabel();
   virtual void EmitFunctionBodyStart();
@@ -14,9 +14,11 @@
 #define DEBUG_TYPE "delay-slot-filler"
 
 #include "Cpu0.h"
+#include "MCTargetDesc/Cpu0BaseInfo.h"
 #include "Cpu0InstrInfo.h"
 #include "Cpu0TargetMachine.h"
 #include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/PointerUnion.h"
 #include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 #include "llvm/Analysis/AliasAnalysis.h"
@@ -32,11 +34,91 @@
 
 using namespace llvm;
 
-STATISTIC(FilledSlots, "Number of delay slots filled");
+STATISTIC(FilledSlots, "Number of delay slots filled with useful instructions");
+STATISTIC(PaddedSlots, "Number of delay slots padded with NOPs");
+
+static cl::opt<bool> DisableDelaySlotFiller(
+  "disable-cpu0-delay-filler",
+  cl::init(false),
+  cl::desc("Fill all delay slots with NOPs."),
+  cl::Hidden);
+
+static cl::opt<bool> DisableSuccBBSearch(
+  "disable-cpu0-df-succbb-search",
+  cl::init(false),
+  cl::desc("Don't search successor basic blocks for delay slot fillers."),
+  cl::Hidden);
 
 namespace {
   typedef MachineBasicBlock::iterator Iter;
   typedef MachineBasicBlock::reverse_iterator ReverseIter;
+  typedef PointerUnion<const Value *, const PseudoSourceValue *> ValueType;
+
+  /// RegDefsUses - Registers defined and used by the instructions that the
+  /// delay slot candidate would be moved across.
+  class RegDefsUses {
+  public:
+    RegDefsUses(const TargetRegisterInfo &TRI)
+      : TRI(TRI), Defs(TRI.getNumRegs(), false),
+        Uses(TRI.getNumRegs(), false) {}
+
+    /// init - Record the registers read and written by the instruction
+    /// owning the delay slot.
+    void init(const MachineInstr &MI);
+
+    /// addLiveIns - Treat the live-in registers of SuccBB as used, so that
+    /// no candidate clobbers a value the other path still needs.
+    void addLiveIns(const MachineBasicBlock &SuccBB);
+
+    /// setUnallocatableRegs - Treat the registers the allocator never hands
+    /// out ($sp, $fp, $gp, $lr, $at, ...) as used. They are live everywhere
+    /// but never appear in the live-in lists.
+    void setUnallocatableRegs(const MachineFunction &MF);
+
+    /// update - Record the register operands [Begin, End) of MI. Return true
+    /// if MI conflicts with the registers recorded so far.
+    bool update(const MachineInstr &MI, unsigned Begin, unsigned End);
+
+  private:
+    bool checkRegDefsUses(BitVector &NewDefs, BitVector &NewUses, unsigned Reg,
+                          bool IsDef) const;
+
+    /// isRegInSet - Return true if Reg or one of its aliases is in RegSet.
+    bool isRegInSet(const BitVector &RegSet, unsigned Reg) const;
+
+    const TargetRegisterInfo &TRI;
+    BitVector Defs, Uses;
+  };
+
+  /// MemDefsUses - Memory locations read and written by the instructions
+  /// that the delay slot candidate would be moved across.
+  class MemDefsUses {
+  public:
+    MemDefsUses(const MachineFrameInfo *MFI_, bool OnlySafeLoads_)
+      : MFI(MFI_), OnlySafeLoads(OnlySafeLoads_), SeenNoObjLoad(false),
+        SeenNoObjStore(false) {}
+
+    /// hasHazard - Return true if MI cannot be moved across the memory
+    /// instructions recorded so far. MI is recorded in any case.
+    bool hasHazard(const MachineInstr &MI);
+
+  private:
+    bool updateDefsUses(ValueType V, bool MayStore);
+
+    /// getUnderlyingObjects - Collect the objects MI may access. Return false
+    /// if they cannot be determined.
+    bool getUnderlyingObjects(const MachineInstr &MI,
+                              SmallVectorImpl<ValueType> &Objects) const;
+
+    /// isSafeLoad - Return true if MI only reads the stack or the constant
+    /// pool, so it may be speculated onto a path it was not on before.
+    bool isSafeLoad(const MachineInstr &MI) const;
+
+    const MachineFrameInfo *MFI;
+    bool OnlySafeLoads;
+    SmallPtrSet<ValueType, 4> Uses, Defs;
+    bool SeenNoObjLoad, SeenNoObjStore;
+  };
 
   class Filler : public MachineFunctionPass {
   public:
@@ -54,9 +136,37 @@ namespace {
         Changed |= runOnMachineBasicBlock(*FI);
       return Changed;
     }
+
+    void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.addRequired<MachineBranchProbabilityInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
   private:
     bool runOnMachineBasicBlock(MachineBasicBlock &MBB);
 
+    /// searchBackward - Search MBB upward from Slot for an instruction that
+    /// can be moved into Slot's delay slot.
+    bool searchBackward(MachineBasicBlock &MBB, Iter Slot) const;
+
+    /// searchSuccBB - Search the most likely successor of MBB for a leading
+    /// instruction that can be moved into Slot's delay slot.
+    bool searchSuccBB(MachineBasicBlock &MBB, Iter Slot) const;
+
+    /// selectSuccBB - Pick the successor, among those reached through Slot,
+    /// whose first instructions are worth hoisting into Slot's delay slot.
+    MachineBasicBlock *selectSuccBB(MachineBasicBlock &MBB,
+                                    const MachineInstr &Slot) const;
+
+    /// delayHasHazard - Return true if Candidate cannot be moved across the
+    /// instructions recorded in RegDU and MemDU.
+    bool delayHasHazard(const MachineInstr &Candidate, RegDefsUses &RegDU,
+                        MemDefsUses &MemDU) const;
+
+    /// terminateSearch - Return true if the search must not move anything
+    /// across Candidate.
+    bool terminateSearch(const MachineInstr &Candidate) const;
+
     TargetMachine &TM;
 
     static char ID;
@@ -68,28 +178,358 @@ static bool hasUnoccupiedSlot(const MachineInstr *MI) {
   return MI->hasDelaySlot() && !MI->isBundledWithSucc();
 }
 
+void RegDefsUses::init(const MachineInstr &MI) {
+  // Only the explicit operands are read or written before the delay slot
+  // executes. Implicit uses of calls and returns (argument and return value
+  // registers) are consumed after the slot and do not constrain it.
+  update(MI, 0, MI.getDesc().getNumOperands());
+
+  // JSUB and JALR write the return address before the delay slot executes.
+  if (MI.isCall())
+    Defs.set(Cpu0::LR);
+
+  // The conditional branches may carry implicit operands; AT is listed as a
+  // def of BEQ/BNE only because of how they are encoded.
+  if (MI.isBranch()) {
+    update(MI, MI.getDesc().getNumOperands(), MI.getNumOperands());
+    Defs.reset(Cpu0::AT);
+  }
+}
+
+void RegDefsUses::addLiveIns(const MachineBasicBlock &SuccBB) {
+  for (MachineBasicBlock::livein_iterator LI = SuccBB.livein_begin(),
+       LE = SuccBB.livein_end(); LI != LE; ++LI)
+    Uses.set(*LI);
+}
+
+void RegDefsUses::setUnallocatableRegs(const MachineFunction &MF) {
+  BitVector AllocSet = TRI.getAllocatableSet(MF);
+
+  for (int R = AllocSet.find_first(); R != -1; R = AllocSet.find_next(R))
+    for (MCRegAliasIterator AI(R, &TRI, false); AI.isValid(); ++AI)
+      AllocSet.set(*AI);
+
+  // Writing $zero is harmless.
+  AllocSet.set(Cpu0::ZERO);
+  Uses |= AllocSet.flip();
+}
+
+bool RegDefsUses::update(const MachineInstr &MI, unsigned Begin, unsigned End) {
+  BitVector NewDefs(TRI.getNumRegs()), NewUses(TRI.getNumRegs());
+  bool HasHazard = false;
+
+  for (unsigned I = Begin; I != End; ++I) {
+    const MachineOperand &MO = MI.getOperand(I);
+
+    if (MO.isReg() && MO.getReg())
+      HasHazard |= checkRegDefsUses(NewDefs, NewUses, MO.getReg(), MO.isDef());
+  }
+
+  Defs |= NewDefs;
+  Uses |= NewUses;
+
+  return HasHazard;
+}
+
+bool RegDefsUses::checkRegDefsUses(BitVector &NewDefs, BitVector &NewUses,
+                                   unsigned Reg, bool IsDef) const {
+  if (IsDef) {
+    NewDefs.set(Reg);
+    // Reg must not have been defined or used already.
+    return isRegInSet(Defs, Reg) || isRegInSet(Uses, Reg);
+  }
+
+  NewUses.set(Reg);
+  // Reg must not have been defined already.
+  return isRegInSet(Defs, Reg);
+}
+
+bool RegDefsUses::isRegInSet(const BitVector &RegSet, unsigned Reg) const {
+  for (MCRegAliasIterator AI(Reg, &TRI, true); AI.isValid(); ++AI)
+    if (RegSet.test(*AI))
+      return true;
+  return false;
+}
+
+bool MemDefsUses::hasHazard(const MachineInstr &MI) {
+  if (!MI.mayLoad() && !MI.mayStore())
+    return false;
+
+  // Loads and stores moved onto a path they were not on before must not
+  // fault or change memory seen by that path.
+  if (OnlySafeLoads && (MI.mayStore() || !isSafeLoad(MI)))
+    return true;
+
+  bool HasHazard = false;
+  SmallVector<ValueType, 4> Objs;
+
+  if (getUnderlyingObjects(MI, Objs)) {
+    for (SmallVectorImpl<ValueType>::const_iterator I = Objs.begin(),
+         E = Objs.end(); I != E; ++I)
+      HasHazard |= updateDefsUses(*I, MI.mayStore());
+    return HasHazard;
+  }
+
+  // The accessed memory is unknown, so it may alias anything.
+  HasHazard = MI.mayStore() && (!Uses.empty() || !Defs.empty() ||
+                                SeenNoObjLoad || SeenNoObjStore);
+  HasHazard |= MI.mayLoad() && (!Defs.empty() || SeenNoObjStore);
+
+  SeenNoObjLoad |= MI.mayLoad();
+  SeenNoObjStore |= MI.mayStore();
+
+  return HasHazard;
+}
+
+bool MemDefsUses::updateDefsUses(ValueType V, bool MayStore) {
+  if (MayStore)
+    return !Defs.insert(V) || Uses.count(V) || SeenNoObjStore ||
+           SeenNoObjLoad;
+
+  Uses.insert(V);
+  return Defs.count(V) || SeenNoObjStore;
+}
+
+bool MemDefsUses::
+getUnderlyingObjects(const MachineInstr &MI,
+                     SmallVectorImpl<ValueType> &Objects) const {
+  if (!MI.hasOneMemOperand() || (*MI.memoperands_begin())->isVolatile())
+    return false;
+
+  const MachineMemOperand *MMO = *MI.memoperands_begin();
+
+  if (const PseudoSourceValue *PSV = MMO->getPseudoValue()) {
+    if (PSV->isAliased(MFI))
+      return false;
+    Objects.push_back(PSV);
+    return true;
+  }
+
+  const Value *V = MMO->getValue();
+  if (!V)
+    return false;
+
+  SmallVector<Value *, 4> Objs;
+  GetUnderlyingObjects(const_cast<Value *>(V), Objs);
+
+  for (SmallVectorImpl<Value *>::iterator I = Objs.begin(), E = Objs.end();
+       I != E; ++I) {
+    if (!isIdentifiedObject(*I))
+      return false;
+    Objects.push_back(*I);
+  }
+
+  return true;
+}
+
+bool MemDefsUses::isSafeLoad(const MachineInstr &MI) const {
+  if (!MI.hasOneMemOperand() || (*MI.memoperands_begin())->isVolatile())
+    return false;
+
+  const PseudoSourceValue *PSV = (*MI.memoperands_begin())->getPseudoValue();
+  if (!PSV)
+    return false;
+
+  return isa<FixedStackPseudoSourceValue>(PSV) || PSV->isConstant(MFI) ||
+         PSV == PseudoSourceValue::getStack();
+}
+
 /// runOnMachineBasicBlock - Fill in delay slots for the given basic block.
 /// We assume there is only one delay slot per delayed instruction.
 bool Filler::runOnMachineBasicBlock(MachineBasicBlock &MBB) {
   bool Changed = false;
+  bool Optimize = !DisableDelaySlotFiller &&
+                  TM.getOptLevel() != CodeGenOpt::None;
 
   for (Iter I = MBB.begin(); I != MBB.end(); ++I) {
     if (!hasUnoccupiedSlot(&*I))
       continue;
 
-    ++FilledSlots;
     Changed = true;
 
-    // Bundle the NOP to the instruction with the delay slot.
-    const Cpu0InstrInfo *TII =
-      static_cast<const Cpu0InstrInfo*>(TM.getInstrInfo());
-    BuildMI(MBB, std::next(I), I->getDebugLoc(), TII->get(Cpu0::NOP));
+    if (Optimize && (searchBackward(MBB, I) || searchSuccBB(MBB, I))) {
+      ++FilledSlots;
+    } else {
+      // Bundle a NOP to the instruction with the delay slot.
+      const Cpu0InstrInfo *TII =
+        static_cast<const Cpu0InstrInfo*>(TM.getInstrInfo());
+      BuildMI(MBB, std::next(I), I->getDebugLoc(), TII->get(Cpu0::NOP));
+      ++PaddedSlots;
+    }
+
     MIBundleBuilder(MBB, I, std::next(I, 2));
   }
 
   return Changed;
 }
 
+bool Filler::searchBackward(MachineBasicBlock &MBB, Iter Slot) const {
+  RegDefsUses RegDU(*TM.getRegisterInfo());
+  MemDefsUses MemDU(MBB.getParent()->getFrameInfo(), false);
+
+  RegDU.init(*Slot);
+
+  for (ReverseIter I(Slot); I != MBB.rend(); ++I) {
+    // Skip debug value.
+    if (I->isDebugValue())
+      continue;
+
+    if (terminateSearch(*I))
+      return false;
+
+    if (delayHasHazard(*I, RegDU, MemDU))
+      continue;
+
+    // Move the instruction just after the one owning the delay slot.
+    MBB.splice(std::next(Slot), &MBB, std::next(I).base());
+    return true;
+  }
+
+  return false;
+}
+
+bool Filler::searchSuccBB(MachineBasicBlock &MBB, Iter Slot) const {
+  if (DisableSuccBBSearch)
+    return false;
+
+  // Only the final branch of MBB transfers control straight into a
+  // successor; calls and returns have nothing to borrow from.
+  if (std::next(Slot) != MBB.end() || Slot->isCall() || Slot->isReturn() ||
+      Slot->isIndirectBranch())
+    return false;
+
+  MachineBasicBlock *SuccBB = selectSuccBB(MBB, *Slot);
+  if (!SuccBB)
+    return false;
+
+  // The instruction taken from SuccBB also runs when MBB reaches any other
+  // successor, so it must not clobber their live-ins or the reserved
+  // registers, store to memory, or load anything other than the stack and
+  // constant pool.
+  RegDefsUses RegDU(*TM.getRegisterInfo());
+  RegDU.setUnallocatableRegs(*MBB.getParent());
+  bool HasOtherSuccs = false;
+
+  for (MachineBasicBlock::succ_iterator SI = MBB.succ_begin(),
+       SE = MBB.succ_end(); SI != SE; ++SI) {
+    if (*SI == SuccBB)
+      continue;
+    RegDU.addLiveIns(**SI);
+    HasOtherSuccs = true;
+  }
+
+  MemDefsUses MemDU(MBB.getParent()->getFrameInfo(), HasOtherSuccs);
+
+  for (Iter I = SuccBB->begin(); I != SuccBB->end(); ++I) {
+    // Skip debug value.
+    if (I->isDebugValue())
+      continue;
+
+    // The prologue of a shrink-wrapped save block must stay in that block.
+    if (terminateSearch(*I) || I->getFlag(MachineInstr::FrameSetup))
+      return false;
+
+    if (delayHasHazard(*I, RegDU, MemDU))
+      continue;
+
+    // The registers it defines are now live into SuccBB. The registers it
+    // reads may still be live on the other paths, so drop its kill flags.
+    MachineInstr *Filler = &*I;
+    for (unsigned OI = 0, OE = Filler->getNumOperands(); OI != OE; ++OI) {
+      const MachineOperand &MO = Filler->getOperand(OI);
+      if (MO.isReg() && MO.isDef() && MO.getReg() &&
+          !SuccBB->isLiveIn(MO.getReg()))
+        SuccBB->addLiveIn(MO.getReg());
+    }
+    Filler->clearKillInfo();
+
+    MBB.splice(std::next(Slot), SuccBB, I);
+    return true;
+  }
+
+  return false;
+}
+
+MachineBasicBlock *Filler::selectSuccBB(MachineBasicBlock &MBB,
+                                        const MachineInstr &Slot) const {
+  const MachineBranchProbabilityInfo &Prob =
+    getAnalysis<MachineBranchProbabilityInfo>();
+  MachineBasicBlock *Best = nullptr;
+  uint32_t BestWeight = 0;
+
+  // The delay slot only executes on the edges Slot itself takes: the target
+  // of a jmp, or both the target and the fall-through of a conditional
+  // branch. In "jeq $T; jmp $F" the jmp's slot never runs on the way to $T.
+  SmallVector<MachineBasicBlock*, 2> Succs;
+  for (unsigned I = 0, E = Slot.getNumOperands(); I != E; ++I)
+    if (Slot.getOperand(I).isMBB())
+      Succs.push_back(Slot.getOperand(I).getMBB());
+
+  if (Slot.isConditionalBranch()) {
+    MachineFunction::iterator Next = &MBB;
+    if (++Next != MBB.getParent()->end())
+      Succs.push_back(Next);
+  }
+
+  for (SmallVectorImpl<MachineBasicBlock*>::iterator SI = Succs.begin(),
+       SE = Succs.end(); SI != SE; ++SI) {
+    MachineBasicBlock *Succ = *SI;
+
+    // The instruction is moved, not duplicated, so MBB must be the only way
+    // into Succ.
+    if (Succ == &MBB || !MBB.isSuccessor(Succ) || Succ->isLandingPad() ||
+        Succ->hasAddressTaken() || Succ->pred_size() != 1)
+      continue;
+
+    uint32_t Weight = Prob.getEdgeWeight(&MBB, Succ);
+    if (!Best || Weight > BestWeight) {
+      Best = Succ;
+      BestWeight = Weight;
+    }
+  }
+
+  return Best;
+}
+
+bool Filler::delayHasHazard(const MachineInstr &Candidate, RegDefsUses &RegDU,
+                            MemDefsUses &MemDU) const {
+  bool HasHazard = Candidate.isImplicitDef() || Candidate.isKill();
+
+  // Pseudo instructions emit nothing (or more than one instruction) and
+  // cannot occupy the slot.
+  HasHazard |=
+    (Candidate.getDesc().TSFlags & Cpu0II::FormMask) == Cpu0II::Pseudo;
+
+  // Filling a slot with a NOP gains nothing.
+  HasHazard |= Candidate.getOpcode() == Cpu0::NOP;
+
+  // The multiply/divide unit updates HI/LO out of the ALU pipeline, and MTSW
+  // rewrites the whole status word. Keep both away from control transfers.
+  switch (Candidate.getOpcode()) {
+  default:
+    break;
+  case Cpu0::MULT: case Cpu0::MULTu: case Cpu0::SDIV: case Cpu0::UDIV:
+  case Cpu0::MFHI: case Cpu0::MFLO: case Cpu0::MTHI: case Cpu0::MTLO:
+  case Cpu0::MFSW: case Cpu0::MTSW:
+    HasHazard = true;
+    break;
+  }
+
+  HasHazard |= MemDU.hasHazard(Candidate);
+  HasHazard |= RegDU.update(Candidate, 0, Candidate.getNumOperands());
+
+  return HasHazard;
+}
+
+bool Filler::terminateSearch(const MachineInstr &Candidate) const {
+  return (Candidate.isTerminator() || Candidate.isCall() ||
+          Candidate.isPosition() || Candidate.isInlineAsm() ||
+          Candidate.hasDelaySlot() || Candidate.isBundle() ||
+          Candidate.hasUnmodeledSideEffects() ||
+          (Candidate.isPseudo() && !Candidate.isKill() &&
+           !Candidate.isImplicitDef()));
+}
+
 /// createCpu0DelaySlotFillerPass - Returns a pass that fills in delay
 /// slots in Cpu0 MachineFunctions
 FunctionPass *llvm::createCpu0DelaySlotFillerPass(Cpu0TargetMachine &tm) {
@@ -7,42 +7,224 @@
 //
 //===----------------------------------------------------------------------===//
 //
-// This pass emits instructions that restore $gp right
-// after jalr instructions.
+// This pass emits instructions that restore $gp after it has been
+// clobbered by a jalr, or on entry to a landing pad.
+//
+// $gp is caller-saved, but most of the time nothing reads it between two
+// calls. Rather than reloading it after every jalr, a forward dataflow over
+// the blocks tracks whether $gp may be stale, and a reload is only placed
+// right before the next instruction that reads it (a GOT access, or the load
+// of the next callee's address). A run of back-to-back calls whose addresses
+// were loaded up front then needs a single reload, or none at all.
+//
+// Calls to static functions of this module leave $gp intact: their own
+// .cpload sets it to the same value, and they restore it before returning.
+// A loop whose calls all go to such functions is entered with $gp already
+// reloaded in its preheader instead of on every iteration.
 //
 //===----------------------------------------------------------------------===//
 
 #define DEBUG_TYPE "emit-gp-restore"
 
 #include "Cpu0.h"
+#include "Cpu0InstrInfo.h"
 #include "Cpu0TargetMachine.h"
 #include "Cpu0MachineFunction.h"
 #include "llvm/CodeGen/MachineFunctionPass.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineLoopInfo.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
 #include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/SmallPtrSet.h"
 #include "llvm/ADT/Statistic.h"
 
 using namespace llvm;
 
+STATISTIC(NumReloads, "Number of $gp reloads inserted");
+
 namespace {
   struct Inserter : public MachineFunctionPass {
 
     TargetMachine &TM;
-    const TargetInstrInfo *TII;
+    const Cpu0InstrInfo *TII;
+    const MachineRegisterInfo *MRI;
+    int FI;
+
+    /// ReturnReadsGP - The function promises its callers to return with
+    /// $gp intact, so every return counts as a read of $gp.
+    bool ReturnReadsGP;
+
+    /// StaleOut - Whether $gp may be stale at the end of each block.
+    DenseMap<MachineBasicBlock*, bool> StaleOut;
+
+    /// ReloadAtEnd - Loop preheaders that make $gp valid before their
+    /// terminators.
+    SmallPtrSet<MachineBasicBlock*, 8> ReloadAtEnd;
+
+    /// PreservesGP - Cache of preservesGP() for the callees seen so far.
+    DenseMap<const Function*, bool> PreservesGP;
+
+    bool Inserted;
 
     static char ID;
     Inserter(TargetMachine &tm)
-      : MachineFunctionPass(ID), TM(tm), TII(tm.getInstrInfo()) { }
+      : MachineFunctionPass(ID), TM(tm),
+        TII(static_cast<const Cpu0InstrInfo*>(tm.getInstrInfo())) { }
 
     virtual const char *getPassName() const {
       return "Cpu0 Emit GP Restore";
     }
 
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+      AU.setPreservesCFG();
+      AU.addRequired<MachineLoopInfo>();
+      AU.addPreserved<MachineLoopInfo>();
+      MachineFunctionPass::getAnalysisUsage(AU);
+    }
+
     bool runOnMachineFunction(MachineFunction &F);
+
+  private:
+    bool preservesGP(const Function *F);
+    bool clobbersGP(const MachineInstr &MI);
+    bool readsGP(const MachineInstr &MI) const;
+    bool loopClobbersGP(const MachineLoop *L, bool &Reads);
+    void markLoops(MachineLoop *L);
+    bool transfer(MachineBasicBlock &MBB, bool Stale, bool Insert);
   };
   char Inserter::ID = 0;
 } // end of anonymous namespace
 
+/// preservesGP - Return true if a call to F returns with $gp unchanged.
+/// F must be compiled along with this function, so that it follows the same
+/// conventions, and must not tail call something that does not.
+bool Inserter::preservesGP(const Function *F) {
+  if (!F || !F->hasLocalLinkage() || F->isDeclaration())
+    return false;
+
+  DenseMap<const Function*, bool>::iterator It = PreservesGP.find(F);
+  if (It != PreservesGP.end())
+    return It->second;
+
+  bool Preserves = true;
+  for (Function::const_iterator BB = F->begin(), E = F->end();
+       BB != E && Preserves; ++BB)
+    for (BasicBlock::const_iterator I = BB->begin(), IE = BB->end(); I != IE;
+         ++I)
+      if (const CallInst *CI = dyn_cast<CallInst>(I))
+        if (CI->isTailCall()) {
+          Preserves = false;
+          break;
+        }
+
+  PreservesGP[F] = Preserves;
+  return Preserves;
+}
+
+/// clobbersGP - Return true if $gp may hold another value after MI. The
+/// callee of a jalr is found through the GOT load of its address.
+bool Inserter::clobbersGP(const MachineInstr &MI) {
+  if (!MI.isCall() || MI.isReturn())
+    return false;
+
+  if (MI.getOpcode() != Cpu0::JALR || !MI.getOperand(0).isReg())
+    return true;
+
+  // jalr $t9, where $t9 is copied from the vreg the address is loaded into.
+  unsigned Reg = MI.getOperand(0).getReg();
+  const MachineInstr *Def = nullptr;
+  for (MachineBasicBlock::const_iterator I(&MI),
+         B = MI.getParent()->begin(); I != B;) {
+    --I;
+    if (I->modifiesRegister(Reg, TM.getRegisterInfo())) {
+      Def = I;
+      break;
+    }
+  }
+
+  if (Def && Def->isCopy() &&
+      TargetRegisterInfo::isVirtualRegister(Def->getOperand(1).getReg()))
+    Def = MRI->getVRegDef(Def->getOperand(1).getReg());
+
+  if (!Def || (Def->getOpcode() != Cpu0::LD &&
+               Def->getOpcode() != Cpu0::LoadGOT) ||
+      !Def->getOperand(2).isGlobal())
+    return true;
+
+  return !preservesGP(dyn_cast<Function>(Def->getOperand(2).getGlobal()));
+}
+
+bool Inserter::readsGP(const MachineInstr &MI) const {
+  if (ReturnReadsGP && MI.isReturn() && !MI.isCall())
+    return true;
+  return MI.readsRegister(Cpu0::GP);
+}
+
+/// loopClobbersGP - Return true if $gp may be clobbered inside L. Reads is
+/// set if anything in L reads $gp.
+bool Inserter::loopClobbersGP(const MachineLoop *L, bool &Reads) {
+  Reads = false;
+  for (MachineLoop::block_iterator BI = L->block_begin(), BE = L->block_end();
+       BI != BE; ++BI) {
+    if ((*BI)->isLandingPad())
+      return true;
+    for (MachineBasicBlock::iterator I = (*BI)->begin(), E = (*BI)->end();
+         I != E; ++I) {
+      if (clobbersGP(*I))
+        return true;
+      Reads |= readsGP(*I);
+    }
+  }
+  return false;
+}
+
+/// markLoops - Reload $gp in the preheader of the outermost loops that read
+/// it but never clobber it.
+void Inserter::markLoops(MachineLoop *L) {
+  bool Reads;
+  if (!loopClobbersGP(L, Reads)) {
+    if (Reads && L->getLoopPreheader())
+      ReloadAtEnd.insert(L->getLoopPreheader());
+    return;
+  }
+
+  for (MachineLoop::iterator I = L->begin(), E = L->end(); I != E; ++I)
+    markLoops(*I);
+}
+
+/// transfer - Walk MBB with $gp stale on entry if Stale is set, and return
+/// whether it may be stale at the end. If Insert is set, emit the reloads.
+bool Inserter::transfer(MachineBasicBlock &MBB, bool Stale, bool Insert) {
+  MachineBasicBlock::iterator FirstTerm = MBB.getFirstTerminator();
+  bool AtEnd = ReloadAtEnd.count(&MBB);
+
+  for (MachineBasicBlock::iterator I = MBB.begin(), E = MBB.end(); ;) {
+    bool NeedGP = (I == FirstTerm && AtEnd) || (I != E && readsGP(*I));
+    if (NeedGP && Stale) {
+      if (Insert) {
+        DebugLoc dl = I != E ? I->getDebugLoc() : DebugLoc();
+        // emit ld $gp, ($gp save slot on stack)
+        BuildMI(MBB, I, dl, TII->get(Cpu0::LD), Cpu0::GP).addFrameIndex(FI)
+                                                         .addImm(0);
+        ++NumReloads;
+        Inserted = true;
+      }
+      Stale = false;
+    }
+
+    if (I == E)
+      break;
+    if (clobbersGP(*I))
+      Stale = true;
+    ++I;
+  }
+
+  return Stale;
+}
+
 bool Inserter::runOnMachineFunction(MachineFunction &F) {
   Cpu0FunctionInfo *Cpu0FI = F.getInfo<Cpu0FunctionInfo>();
 
@@ -50,45 +232,84 @@ bool Inserter::runOnMachineFunction(MachineFunction &F) {
       (!Cpu0FI->globalBaseRegFixed()))
     return false;
 
-  bool Changed = false;
-  int FI = Cpu0FI->getGPFI();
+  // $gp is an ordinary callee-saved register in this function. Nothing
+  // reads the global base, so there is nothing to restore.
+  if (!Cpu0FI->globalBaseRegReserved()) {
+    Cpu0FI->setGPFI(0);
+    return false;
+  }
+
+  // The .cpload at entry is only needed if something still reads $gp now
+  // that the DAG has been optimized.
+  MRI = &F.getRegInfo();
+  Cpu0FI->setUsesGP(!MRI->use_nodbg_empty(Cpu0::GP));
+
+  // No save slot means no call that returns here.
+  FI = Cpu0FI->getGPFI();
+  if (!FI)
+    return false;
 
+  Inserted = false;
+  ReturnReadsGP = preservesGP(F.getFunction());
+  StaleOut.clear();
+  ReloadAtEnd.clear();
+
+  // The GOT load pseudos may be rematerialized anywhere by the register
+  // allocator. Once $gp can go stale that is no longer safe, so expand them
+  // now that MachineLICM and MachineCSE are done with them.
+  SmallVector<MachineInstr*, 16> GOTLoads;
+  bool Clobbers = false;
   for (MachineFunction::iterator MFI = F.begin(), MFE = F.end();
-       MFI != MFE; ++MFI) {
-    MachineBasicBlock& MBB = *MFI;
-    MachineBasicBlock::iterator I = MFI->begin();
-    
-    /// IsLandingPad - Indicate that this basic block is entered via an
-    /// exception handler.
-    // If MBB is a landing pad, insert instruction that restores $gp after
-    // EH_LABEL.
-    if (MBB.isLandingPad()) {
-      // Find EH_LABEL first.
-      for (; I->getOpcode() != TargetOpcode::EH_LABEL; ++I) ;
-
-      // Insert ld.
-      ++I;
-      DebugLoc dl = I != MBB.end() ? I->getDebugLoc() : DebugLoc();
-      BuildMI(MBB, I, dl, TII->get(Cpu0::LD), Cpu0::GP).addFrameIndex(FI)
-                                                       .addImm(0);
-      Changed = true;
+       MFI != MFE; ++MFI)
+    for (MachineBasicBlock::iterator I = MFI->begin(), E = MFI->end();
+         I != E; ++I) {
+      if (I->getOpcode() == Cpu0::LoadGOT ||
+          I->getOpcode() == Cpu0::LoadGOTAddr)
+        GOTLoads.push_back(I);
+      Clobbers |= clobbersGP(*I);
     }
+  if (Clobbers)
+    for (unsigned i = 0, e = GOTLoads.size(); i != e; ++i)
+      TII->expandGOTLoad(GOTLoads[i]);
 
-    while (I != MFI->end()) {
-      if (I->getOpcode() != Cpu0::JALR) {
-        ++I;
-        continue;
-      }
+  MachineLoopInfo &MLI = getAnalysis<MachineLoopInfo>();
+  for (MachineLoopInfo::iterator I = MLI.begin(), E = MLI.end(); I != E; ++I)
+    markLoops(*I);
 
-      DebugLoc dl = I->getDebugLoc();
-      // emit ld $gp, ($gp save slot on stack) after jalr
-      BuildMI(MBB, ++I, dl, TII->get(Cpu0::LD), Cpu0::GP).addFrameIndex(FI)
-                                                         .addImm(0);
-      Changed = true;
+  // $gp is set up on entry, and unknown when a landing pad is entered from
+  // the unwinder. Elsewhere it may be stale if it is on any incoming edge.
+  bool Changed = true;
+  while (Changed) {
+    Changed = false;
+    for (MachineFunction::iterator MFI = F.begin(), MFE = F.end();
+         MFI != MFE; ++MFI) {
+      bool Stale = MFI->isLandingPad();
+      for (MachineBasicBlock::pred_iterator PI = MFI->pred_begin(),
+             PE = MFI->pred_end(); PI != PE && !Stale; ++PI)
+        Stale = StaleOut[*PI];
+
+      bool Out = transfer(*MFI, Stale, false);
+      if (Out != StaleOut[MFI]) {
+        StaleOut[MFI] = Out;
+        Changed = true;
+      }
     }
   }
 
-  return Changed;
+  for (MachineFunction::iterator MFI = F.begin(), MFE = F.end();
+       MFI != MFE; ++MFI) {
+    bool Stale = MFI->isLandingPad();
+    for (MachineBasicBlock::pred_iterator PI = MFI->pred_begin(),
+           PE = MFI->pred_end(); PI != PE && !Stale; ++PI)
+      Stale = StaleOut[*PI];
+    transfer(*MFI, Stale, true);
+  }
+
+  // Without a reload the .cprestore and its stack slot are dead as well.
+  if (!Inserted)
+    Cpu0FI->setGPFI(0);
+
+  return Inserted || (Clobbers && !GOTLoads.empty());
 }
 
 /// createCpu0EmitGPRestorePass - Returns a pass that emits instructions that
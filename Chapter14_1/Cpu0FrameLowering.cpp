@@ -12,9 +12,9 @@
 //===----------------------------------------------------------------------===//
 
 #include "Cpu0FrameLowering.h"
-#include "Cpu0AnalyzeImmediate.h"
 #include "Cpu0InstrInfo.h"
 #include "Cpu0MachineFunction.h"
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
 #include "llvm/IR/Function.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
@@ -27,6 +27,12 @@
 
 using namespace llvm;
 
+static cl::opt<bool> EnableShrinkWrap(
+  "cpu0-shrink-wrap",
+  cl::init(true),
+  cl::desc("Set up the frame after an early return of the entry block."),
+  cl::Hidden);
+
 //- emitPrologue() and emitEpilogue must exist for main(). 
 
 //===----------------------------------------------------------------------===//
@@ -84,23 +90,102 @@ using namespace llvm;
 //- Must have, hasFP() is pure virtual of parent
 // hasFP - Return true if the specified function should have a dedicated frame
 // pointer register.  This is true if the function has variable sized allocas or
-// if frame pointer elimination is disabled.
+// if frame pointer elimination is disabled. A leaf function never links a
+// frame, so it does not pay for $fp even when elimination is disabled.
 bool Cpu0FrameLowering::hasFP(const MachineFunction &MF) const {
   const MachineFrameInfo *MFI = MF.getFrameInfo();
-  return MF.getTarget().Options.DisableFramePointerElim(MF) ||
+  return (MF.getTarget().Options.DisableFramePointerElim(MF) &&
+          MFI->hasCalls()) ||
       MFI->hasVarSizedObjects() || MFI->isFrameAddressTaken();
 } // lbd document - mark - hasFP
 
+// Return true if MI needs the frame: it calls, touches a stack object,
+// $sp or $fp, or clobbers a callee-saved register before it is spilled.
+static bool needsFrame(const MachineInstr &MI, const uint16_t *CSRegs,
+                       const TargetRegisterInfo *TRI) {
+  if (MI.isCall() || MI.hasUnmodeledSideEffects())
+    return true;
+
+  for (unsigned i = 0, e = MI.getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI.getOperand(i);
+    if (MO.isFI() || MO.isRegMask())
+      return true;
+    if (MO.isReg() && (MO.getReg() == Cpu0::SP || MO.getReg() == Cpu0::FP))
+      return true;
+  }
+
+  for (unsigned i = 0; CSRegs[i]; ++i)
+    if (MI.modifiesRegister(CSRegs[i], TRI))
+      return true;
+
+  return false;
+}
+
+// findShrinkWrapBlocks - Look for an entry block that ends in a conditional
+// branch to a return block, where neither block needs the frame, e.g.
+//
+//   entry:  cmp/slt ...; jeq/beq $exit
+//   body:   <real work, calls>
+//   exit:   addiu $2, $zero, -1; ret $lr
+//
+// The prologue and the callee-saved spills can then be set up at the start
+// of the other successor, which dominates every block but these two, and
+// the early return leaves without touching $sp. PrologEpilogInserter has no
+// save/restore point support, so the blocks are recorded in Cpu0FunctionInfo
+// and honoured by the hooks below.
+static void findShrinkWrapBlocks(MachineFunction &MF,
+                                 MachineBasicBlock *&SaveMBB,
+                                 MachineBasicBlock *&ExitMBB) {
+  SaveMBB = ExitMBB = nullptr;
+
+  // The CFI of the prologue is emitted in layout order, which may put the
+  // early return after it. Only split when no unwind or debug frame
+  // information is emitted.
+  if (MF.getFunction()->needsUnwindTableEntry() ||
+      MF.getMMI().hasDebugInfo())
+    return;
+
+  MachineBasicBlock &Entry = MF.front();
+  if (Entry.succ_size() != 2 || !Entry.pred_empty())
+    return;
+
+  const TargetRegisterInfo *TRI = MF.getTarget().getRegisterInfo();
+  const uint16_t *CSRegs = TRI->getCalleeSavedRegs(&MF);
+
+  for (MachineBasicBlock::iterator I = Entry.begin(), E = Entry.end();
+       I != E; ++I)
+    if (needsFrame(*I, CSRegs, TRI))
+      return;
+
+  MachineBasicBlock *Succ0 = *Entry.succ_begin();
+  MachineBasicBlock *Succ1 = *(Entry.succ_begin() + 1);
+  MachineBasicBlock *Exit = Succ0, *Save = Succ1;
+  if (!Exit->isReturnBlock())
+    std::swap(Exit, Save);
+  if (!Exit->isReturnBlock() || !Exit->succ_empty() || Exit->pred_size() != 1 ||
+      Save->pred_size() != 1 || Save->isLandingPad())
+    return;
+
+  for (MachineBasicBlock::iterator I = Exit->begin(), E = Exit->end();
+       I != E; ++I)
+    if (!I->isReturn() && needsFrame(*I, CSRegs, TRI))
+      return;
+
+  SaveMBB = Save;
+  ExitMBB = Exit;
+}
+
 // Build an instruction sequence to load an immediate that is too large to fit
 // in 16-bit and add the result to Reg.
 static void expandLargeImm(unsigned Reg, int64_t Imm, 
                            const Cpu0InstrInfo &TII, MachineBasicBlock& MBB,
-                           MachineBasicBlock::iterator II, DebugLoc DL) {
+                           MachineBasicBlock::iterator II, DebugLoc DL,
+                           Cpu0AnalyzeImmediate &AnalyzeImm,
+                           MachineInstr::MIFlag Flag) {
   unsigned LUi = Cpu0::LUi;
   unsigned ADDu = Cpu0::ADDu;
   unsigned ZEROReg = Cpu0::ZERO;
   unsigned ATReg = Cpu0::AT;
-  Cpu0AnalyzeImmediate AnalyzeImm;
   const Cpu0AnalyzeImmediate::InstSeq &Seq =
     AnalyzeImm.Analyze(Imm, 32, false /* LastInstrIsADDiu */);
   Cpu0AnalyzeImmediate::InstSeq::const_iterator Inst = Seq.begin();
@@ -110,23 +195,25 @@ static void expandLargeImm(unsigned Reg, int64_t Imm,
   // operand.
   if (Inst->Opc == LUi)
     BuildMI(MBB, II, DL, TII.get(LUi), ATReg)
-      .addImm(SignExtend64<16>(Inst->ImmOpnd));
+      .addImm(SignExtend64<16>(Inst->ImmOpnd)).setMIFlag(Flag);
   else
     BuildMI(MBB, II, DL, TII.get(Inst->Opc), ATReg).addReg(ZEROReg)
-      .addImm(SignExtend64<16>(Inst->ImmOpnd));
+      .addImm(SignExtend64<16>(Inst->ImmOpnd)).setMIFlag(Flag);
 
   // Build the remaining instructions in Seq.
   for (++Inst; Inst != Seq.end(); ++Inst)
     BuildMI(MBB, II, DL, TII.get(Inst->Opc), ATReg).addReg(ATReg)
-      .addImm(SignExtend64<16>(Inst->ImmOpnd));
+      .addImm(SignExtend64<16>(Inst->ImmOpnd)).setMIFlag(Flag);
 
-  BuildMI(MBB, II, DL, TII.get(ADDu), Reg).addReg(Reg).addReg(ATReg);
+  BuildMI(MBB, II, DL, TII.get(ADDu), Reg).addReg(Reg).addReg(ATReg)
+    .setMIFlag(Flag);
 } // lbd document - mark - expandLargeImm
 
 void Cpu0FrameLowering::emitPrologue(MachineFunction &MF) const {
-  MachineBasicBlock &MBB   = MF.front();
-  MachineFrameInfo *MFI    = MF.getFrameInfo();
   Cpu0FunctionInfo *Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
+  MachineBasicBlock &MBB   =
+    Cpu0FI->getSaveBlock() ? *Cpu0FI->getSaveBlock() : MF.front();
+  MachineFrameInfo *MFI    = MF.getFrameInfo();
   const Cpu0InstrInfo &TII =
     *static_cast<const Cpu0InstrInfo*>(MF.getTarget().getInstrInfo());
   MachineBasicBlock::iterator MBBI = MBB.begin();
@@ -151,19 +238,24 @@ void Cpu0FrameLowering::emitPrologue(MachineFunction &MF) const {
    // Update stack size
   MFI->setStackSize(StackSize);
 
-  // No need to allocate space on the stack.
+  // No need to allocate space on the stack. This is the common case for a
+  // leaf function: no frame, no CFI, nothing to restore.
   if (StackSize == 0 && !MFI->adjustsStack()) return;
 
   MachineModuleInfo &MMI = MF.getMMI();
   const MCRegisterInfo *MRI = MMI.getContext().getRegisterInfo();
   MachineLocation DstML, SrcML;
 
-  // Adjust stack.
+  // Adjust stack. The adjustment is flagged FrameSetup so that the delay
+  // slot filler never hoists it out of a shrink-wrapped save block into the
+  // entry block's branch, where the early return would run it too.
   if (isInt<16>(-StackSize)) // addiu sp, sp, (-stacksize)
-    BuildMI(MBB, MBBI, dl, TII.get(ADDiu), SP).addReg(SP).addImm(-StackSize);
+    BuildMI(MBB, MBBI, dl, TII.get(ADDiu), SP).addReg(SP).addImm(-StackSize)
+      .setMIFlag(MachineInstr::FrameSetup);
   else { // Expand immediate that doesn't fit in 16-bit.
     Cpu0FI->setEmitNOAT();
-    expandLargeImm(SP, -StackSize, TII, MBB, MBBI, dl);
+    expandLargeImm(SP, -StackSize, TII, MBB, MBBI, dl, AnalyzeImm,
+                   MachineInstr::FrameSetup);
   }
 
   // emit ".cfi_def_cfa_offset StackSize"
@@ -219,12 +311,18 @@ void Cpu0FrameLowering::emitPrologue(MachineFunction &MF) const {
 
 void Cpu0FrameLowering::emitEpilogue(MachineFunction &MF,
                                  MachineBasicBlock &MBB) const {
+  // MBBI is the return, or the TAILCALL/TAILCALL_R jump of a tail call. The
+  // epilogue is inserted in front of it in both cases.
   MachineBasicBlock::iterator MBBI = MBB.getLastNonDebugInstr();
   MachineFrameInfo *MFI            = MF.getFrameInfo();
   Cpu0FunctionInfo *Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
   const Cpu0InstrInfo &TII =
     *static_cast<const Cpu0InstrInfo*>(MF.getTarget().getInstrInfo());
   DebugLoc dl = MBBI->getDebugLoc();
+
+  // The early return runs before the frame is set up.
+  if (&MBB == Cpu0FI->getEarlyExitBlock())
+    return;
   unsigned SP = Cpu0::SP;
  // lbd document - mark - emitEpilogue() Cpu0::SP
   unsigned FP = Cpu0::FP;
@@ -256,7 +354,8 @@ void Cpu0FrameLowering::emitEpilogue(MachineFunction &MF,
     BuildMI(MBB, MBBI, dl, TII.get(ADDiu), SP).addReg(SP).addImm(StackSize);
   else { // Expand immediate that doesn't fit in 16-bit.
     Cpu0FI->setEmitNOAT();
-    expandLargeImm(SP, StackSize, TII, MBB, MBBI, dl);
+    expandLargeImm(SP, StackSize, TII, MBB, MBBI, dl, AnalyzeImm,
+                   MachineInstr::NoFlags);
   }
 }
 
@@ -267,8 +366,16 @@ bool Cpu0FrameLowering::spillCalleeSavedRegisters(
                           const TargetRegisterInfo *TRI) const {
   MachineFunction *MF = MBB.getParent();
   MachineBasicBlock *EntryBlock = MF->begin();
+  MachineBasicBlock *SaveBlock =
+    MF->getInfo<Cpu0FunctionInfo>()->getSaveBlock();
   const TargetInstrInfo &TII = *MF->getTarget().getInstrInfo();
 
+  // The registers are live through the entry block down to the spills.
+  if (SaveBlock)
+    MI = SaveBlock->begin();
+  else
+    SaveBlock = EntryBlock;
+
   for (unsigned i = 0, e = CSI.size(); i != e; ++i) {
     // Add the callee-saved register as live-in. Do not add if the register is
     // RA and return address is taken, because it has already been added in
@@ -278,19 +385,34 @@ bool Cpu0FrameLowering::spillCalleeSavedRegisters(
     unsigned Reg = CSI[i].getReg();
     bool IsRAAndRetAddrIsTaken = (Reg == Cpu0::LR)
         && MF->getFrameInfo()->isReturnAddressTaken();
-    if (!IsRAAndRetAddrIsTaken)
+    if (!IsRAAndRetAddrIsTaken) {
       EntryBlock->addLiveIn(Reg);
+      if (SaveBlock != EntryBlock)
+        SaveBlock->addLiveIn(Reg);
+    }
 
     // Insert the spill to the stack frame.
     bool IsKill = !IsRAAndRetAddrIsTaken;
     const TargetRegisterClass *RC = TRI->getMinimalPhysRegClass(Reg);
-    TII.storeRegToStackSlot(*EntryBlock, MI, Reg, IsKill,
+    TII.storeRegToStackSlot(*SaveBlock, MI, Reg, IsKill,
                             CSI[i].getFrameIdx(), RC, TRI);
   }
 
   return true;
 }
 
+bool Cpu0FrameLowering::restoreCalleeSavedRegisters(
+                          MachineBasicBlock &MBB,
+                          MachineBasicBlock::iterator MI,
+                          const std::vector<CalleeSavedInfo> &CSI,
+                          const TargetRegisterInfo *TRI) const {
+  // Nothing was saved yet on the early return. Everywhere else let
+  // PrologEpilogInserter reload the registers.
+  const Cpu0FunctionInfo *Cpu0FI =
+    MBB.getParent()->getInfo<Cpu0FunctionInfo>();
+  return &MBB == Cpu0FI->getEarlyExitBlock();
+}
+
 // This function eliminate ADJCALLSTACKDOWN,
 // ADJCALLSTACKUP pseudo instructions
 void Cpu0FrameLowering::
@@ -329,6 +451,13 @@ processFunctionBeforeCalleeSavedScan(MachineFunction &MF,
   Cpu0FunctionInfo *Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
   unsigned FP = Cpu0::FP;
 
+  // Decide where the frame is set up before the callee-saved spills are
+  // inserted.
+  MachineBasicBlock *SaveMBB = nullptr, *ExitMBB = nullptr;
+  if (EnableShrinkWrap)
+    findShrinkWrapBlocks(MF, SaveMBB, ExitMBB);
+  Cpu0FI->setShrinkWrapBlocks(SaveMBB, ExitMBB);
+
   // Mark $fp as used if function has dedicated frame pointer.
   if (hasFP(MF))
     MRI.setPhysRegUsed(FP);
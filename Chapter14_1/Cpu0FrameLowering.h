@@ -15,6 +15,7 @@
 
 #include "Cpu0.h"
 #include "Cpu0Subtarget.h"
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
 #include "llvm/Target/TargetFrameLowering.h"
 
 namespace llvm {
@@ -24,6 +25,10 @@ class Cpu0FrameLowering : public TargetFrameLowering {
 protected:
   const Cpu0Subtarget &STI;
 
+  /// AnalyzeImm - Builds the large stack adjustments. It is kept for the
+  /// whole module so that frames of the same size share one analysis.
+  mutable Cpu0AnalyzeImmediate AnalyzeImm;
+
 public:
   explicit Cpu0FrameLowering(const Cpu0Subtarget &sti)
     : TargetFrameLowering(StackGrowsDown, 8, 0),
@@ -42,6 +47,10 @@ public:
                                  MachineBasicBlock::iterator MI,
                                  const std::vector<CalleeSavedInfo> &CSI,
                                  const TargetRegisterInfo *TRI) const;
+  bool restoreCalleeSavedRegisters(MachineBasicBlock &MBB,
+                                   MachineBasicBlock::iterator MI,
+                                   const std::vector<CalleeSavedInfo> &CSI,
+                                   const TargetRegisterInfo *TRI) const;
   void processFunctionBeforeCalleeSavedScan(MachineFunction &MF,
                                             RegScavenger *RS) const;
 };
@@ -174,6 +174,23 @@ SelectAddr(SDNode *Parent, SDValue Addr, SDValue &Base, SDValue &Offset) {
     }
   } // lbd document - mark - if (CurDAG->isBaseWithConstantOffset(Addr))
 
+  // Fold the low part of a global address, %lo(sym+off) or %gp_rel(sym+off),
+  // or of a $gp pool constant, %gp_rel($CPI), into the load/store immediate
+  // instead of a separate addiu/add.
+  if (Addr.getOpcode() == ISD::ADD) {
+    unsigned Opc = Addr.getOperand(1).getOpcode();
+    if (Opc == Cpu0ISD::Lo || Opc == Cpu0ISD::GPRel) {
+      SDValue Opnd0 = Addr.getOperand(1).getOperand(0);
+      if (Opnd0.getOpcode() == ISD::TargetGlobalAddress ||
+          Opnd0.getOpcode() == ISD::TargetJumpTable ||
+          Opnd0.getOpcode() == ISD::TargetConstantPool) {
+        Base = Addr.getOperand(0);
+        Offset = Opnd0;
+        return true;
+      }
+    }
+  }
+
   Base   = Addr;
   Offset = CurDAG->getTargetConstant(0, ValTy);
   return true;
@@ -18,16 +18,23 @@
 #include "Cpu0TargetMachine.h"
 #include "Cpu0TargetObjectFile.h"
 #include "Cpu0Subtarget.h"
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
 #include "MCTargetDesc/Cpu0BaseInfo.h"
+#include "llvm/ADT/SmallPtrSet.h"
+#include "llvm/ADT/Statistic.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Constants.h"
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Function.h"
 #include "llvm/IR/GlobalVariable.h"
 #include "llvm/IR/Intrinsics.h"
+#include "llvm/IR/Module.h"
 #include "llvm/IR/CallingConv.h"
 #include "llvm/CodeGen/CallingConvLower.h"
 #include "llvm/CodeGen/MachineFrameInfo.h"
 #include "llvm/CodeGen/MachineFunction.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineJumpTableInfo.h"
 #include "llvm/CodeGen/MachineRegisterInfo.h"
 #include "llvm/CodeGen/SelectionDAG.h"
 #include "llvm/CodeGen/SelectionDAGISel.h"
@@ -39,6 +46,32 @@
 
 using namespace llvm;
 
+// Alignments are in log2 bytes. The defaults keep the natural word alignment
+// and add no padding; raise them to line loops and functions up with the
+// fetch buffer or cache line of a particular implementation.
+static cl::opt<unsigned> Cpu0FunctionAlign(
+  "cpu0-function-align",
+  cl::init(2),
+  cl::desc("Preferred function alignment for Cpu0, in log2 bytes."),
+  cl::Hidden);
+
+static cl::opt<unsigned> Cpu0LoopAlign(
+  "cpu0-loop-align",
+  cl::init(2),
+  cl::desc("Preferred loop header alignment for Cpu0, in log2 bytes."),
+  cl::Hidden);
+
+static cl::opt<unsigned> GPConstPoolMinSites(
+  "cpu0-gp-const-pool-min-sites",
+  cl::init(4),
+  cl::desc("Number of blocks that must build the same 32-bit constant "
+           "before it is loaded from the $gp constant pool when not "
+           "optimizing for size."),
+  cl::Hidden);
+
+STATISTIC(NumTailCalls, "Number of tail calls");
+STATISTIC(NumGPConstLoads, "Number of constants loaded from the $gp pool");
+
 SDValue Cpu0TargetLowering::getGlobalReg(SelectionDAG &DAG, EVT Ty) const {
   Cpu0FunctionInfo *FI = DAG.getMachineFunction().getInfo<Cpu0FunctionInfo>();
   return DAG.getRegister(FI->getGlobalBaseReg(), Ty);
@@ -85,7 +118,7 @@ SDValue Cpu0TargetLowering::getAddrLocal(SDValue Op, SelectionDAG &DAG) const {
   SDValue GOT = DAG.getNode(Cpu0ISD::Wrapper, DL, Ty, getGlobalReg(DAG, Ty),
                             getTargetNode(Op, DAG, GOTFlag));
   SDValue Load = DAG.getLoad(Ty, DL, DAG.getEntryNode(), GOT,
-                             MachinePointerInfo::getGOT(), false, false, false,
+                             MachinePointerInfo::getGOT(), false, false, true,
                              0);
   unsigned LoFlag = Cpu0II::MO_ABS_LO;
   SDValue Lo = DAG.getNode(Cpu0ISD::Lo, DL, Ty, getTargetNode(Op, DAG, LoFlag));
@@ -99,7 +132,7 @@ SDValue Cpu0TargetLowering::getAddrGlobal(SDValue Op, SelectionDAG &DAG,
   SDValue Tgt = DAG.getNode(Cpu0ISD::Wrapper, DL, Ty, getGlobalReg(DAG, Ty),
                             getTargetNode(Op, DAG, Flag));
   return DAG.getLoad(Ty, DL, DAG.getEntryNode(), Tgt,
-                     MachinePointerInfo::getGOT(), false, false, false, 0);
+                     MachinePointerInfo::getGOT(), false, false, true, 0);
 }
 
 SDValue Cpu0TargetLowering::getAddrGlobalLargeGOT(SDValue Op, SelectionDAG &DAG,
@@ -112,12 +145,13 @@ SDValue Cpu0TargetLowering::getAddrGlobalLargeGOT(SDValue Op, SelectionDAG &DAG,
   SDValue Wrapper = DAG.getNode(Cpu0ISD::Wrapper, DL, Ty, Hi,
                                 getTargetNode(Op, DAG, LoFlag));
   return DAG.getLoad(Ty, DL, DAG.getEntryNode(), Wrapper,
-                     MachinePointerInfo::getGOT(), false, false, false, 0);
+                     MachinePointerInfo::getGOT(), false, false, true, 0);
 }
 
 const char *Cpu0TargetLowering::getTargetNodeName(unsigned Opcode) const {
   switch (Opcode) {
   case Cpu0ISD::JmpLink:           return "Cpu0ISD::JmpLink";
+  case Cpu0ISD::TailCall:          return "Cpu0ISD::TailCall";
   case Cpu0ISD::Hi:                return "Cpu0ISD::Hi";
   case Cpu0ISD::Lo:                return "Cpu0ISD::Lo";
   case Cpu0ISD::GPRel:             return "Cpu0ISD::GPRel";
@@ -125,6 +159,7 @@ const char *Cpu0TargetLowering::getTargetNodeName(unsigned Opcode) const {
   case Cpu0ISD::DivRem:            return "Cpu0ISD::DivRem";
   case Cpu0ISD::DivRemU:           return "Cpu0ISD::DivRemU";
   case Cpu0ISD::Wrapper:           return "Cpu0ISD::Wrapper";
+  case Cpu0ISD::JTEntry:           return "Cpu0ISD::JTEntry";
   default:                         return NULL;
   }
 } // lbd document - mark - getTargetNodeName
@@ -162,6 +197,12 @@ Cpu0TargetLowering(Cpu0TargetMachine &TM)
   setOperationAction(ISD::BRCOND,             MVT::Other, Custom);
   setOperationAction(ISD::VASTART,            MVT::Other, Custom);
 
+  // Only -cpu0-gp-const-pool lowers constants, see lowerConstant.
+  const Cpu0TargetObjectFile &TLOF =
+    (const Cpu0TargetObjectFile&)getObjFileLowering();
+  if (TLOF.IsConstantInSmallSection(TM))
+    setOperationAction(ISD::Constant,         MVT::i32,   Custom);
+
   // Handle i64 shl such as the following,
   //   %sh_prom = zext i32 %b to i64
   //   %shl = shl i64 %a, %sh_prom
@@ -181,8 +222,10 @@ Cpu0TargetLowering(Cpu0TargetMachine &TM)
   setOperationAction(ISD::UDIV, MVT::i32, Expand);
   setOperationAction(ISD::UREM, MVT::i32, Expand);
 
+  // Jump tables hold 16-bit entries, see lowerBR_JT.
+  setOperationAction(ISD::BR_JT,             MVT::Other, Custom);
+
   // Operations not directly supported by Cpu0.
-  setOperationAction(ISD::BR_JT,             MVT::Other, Expand);
   setOperationAction(ISD::BR_CC,             MVT::i32, Expand);
   setOperationAction(ISD::SELECT_CC,         MVT::i32, Expand);
   setOperationAction(ISD::SELECT_CC,         MVT::Other, Expand);
@@ -196,13 +239,32 @@ Cpu0TargetLowering(Cpu0TargetMachine &TM)
 
   setTargetDAGCombine(ISD::SDIVREM);
   setTargetDAGCombine(ISD::UDIVREM);
+  setTargetDAGCombine(ISD::MUL);
+
+  // Expand small memcpy/memset/memmove inline. A word is an ld/st pair,
+  // against the jsub, its delay slot and the argument setup of a call.
+  // Larger word aligned blocks are handled by Cpu0SelectionDAGInfo.
+  MaxStoresPerMemcpy = 16;
+  MaxStoresPerMemcpyOptSize = 4;
+  MaxStoresPerMemset = 16;
+  MaxStoresPerMemsetOptSize = 4;
+  MaxStoresPerMemmove = 8;
+  MaxStoresPerMemmoveOptSize = 4;
 
 //- Set .align 2
 // It will emit .align 2 later
   setMinFunctionAlignment(2);
+  // Padding is filled with nop, see Cpu0AsmBackend::writeNopData.
+  setPrefFunctionAlignment(std::max(2U, (unsigned)Cpu0FunctionAlign));
+  setPrefLoopAlignment(std::max(2U, (unsigned)Cpu0LoopAlign));
 
   setStackPointerRegisterToSaveRestore(Cpu0::SP);
 
+  // A jump table dispatch is about 8 instructions (range check, table
+  // address, shl, lh, add, jr and its delay slot). A compare tree over four
+  // cases is two levels of compare and branch, which is no longer.
+  setMinimumJumpTableEntries(5);
+
 // must, computeRegisterProperties - Once all of the register classes are 
 //  added, this allows us to compute derived properties we expose.
   computeRegisterProperties();
@@ -248,6 +310,91 @@ static SDValue PerformDivRemCombine(SDNode *N, SelectionDAG& DAG,
   return SDValue();
 }
 
+/// countConstMultSteps - Return the number of shl, addu and subu
+/// genConstMult emits to multiply by C. A shl needed twice is counted
+/// twice, although the DAG shares it, so this errs on the long side.
+static unsigned countConstMultSteps(const APInt &C) {
+  if (C == 0 || C == 1)
+    return 0;
+  if (C.isPowerOf2())
+    return 1;
+
+  unsigned BitWidth = C.getBitWidth();
+  APInt Floor = APInt(BitWidth, 1) << C.logBase2();
+  APInt Ceil = C.isNegative() ? APInt(BitWidth, 0) :
+                                APInt(BitWidth, 1) << C.ceilLogBase2();
+  if ((C - Floor).ule(Ceil - C))
+    return countConstMultSteps(Floor) + countConstMultSteps(C - Floor) + 1;
+  return countConstMultSteps(Ceil) + countConstMultSteps(Ceil - C) + 1;
+}
+
+/// genConstMult - Build X * C from shifts, adds and subtracts. C is split
+/// around the nearer of the powers of two below and above it:
+///   x * c = x * floor + x * (c - floor)  or  x * ceil - x * (ceil - c).
+/// A negative C is 0 - x * -C.
+static SDValue genConstMult(SDValue X, const APInt &C, SDLoc DL, EVT VT,
+                            EVT ShiftTy, SelectionDAG &DAG) {
+  if (C == 0)
+    return DAG.getConstant(0, VT);
+  if (C == 1)
+    return X;
+  if (C.isPowerOf2())
+    return DAG.getNode(ISD::SHL, DL, VT, X,
+                       DAG.getConstant(C.logBase2(), ShiftTy));
+
+  unsigned BitWidth = C.getBitWidth();
+  APInt Floor = APInt(BitWidth, 1) << C.logBase2();
+  APInt Ceil = C.isNegative() ? APInt(BitWidth, 0) :
+                                APInt(BitWidth, 1) << C.ceilLogBase2();
+
+  if ((C - Floor).ule(Ceil - C)) {
+    SDValue Op0 = genConstMult(X, Floor, DL, VT, ShiftTy, DAG);
+    SDValue Op1 = genConstMult(X, C - Floor, DL, VT, ShiftTy, DAG);
+    return DAG.getNode(ISD::ADD, DL, VT, Op0, Op1);
+  }
+
+  SDValue Op0 = genConstMult(X, Ceil, DL, VT, ShiftTy, DAG);
+  SDValue Op1 = genConstMult(X, Ceil - C, DL, VT, ShiftTy, DAG);
+  return DAG.getNode(ISD::SUB, DL, VT, Op0, Op1);
+}
+
+/// PerformMULCombine - Turn a multiply by a constant into shl/addu/subu
+/// when the chain, one ALU cycle per step, beats the latency of mul. When
+/// optimizing for size the chain may not be longer than the mul and the
+/// instructions that load the constant.
+static SDValue PerformMULCombine(SDNode *N, SelectionDAG &DAG,
+                                 TargetLowering::DAGCombinerInfo &DCI,
+                                 const Cpu0TargetLowering *TL) {
+  // Let the generic combines see the multiply first.
+  if (DCI.isBeforeLegalize())
+    return SDValue();
+
+  EVT VT = N->getValueType(0);
+  ConstantSDNode *C = dyn_cast<ConstantSDNode>(N->getOperand(1));
+  if (VT != MVT::i32 || !C)
+    return SDValue();
+
+  const APInt &Imm = C->getAPIntValue();
+  unsigned Steps = countConstMultSteps(Imm);
+
+  const Function *F = DAG.getMachineFunction().getFunction();
+  if (F->getAttributes().hasAttribute(AttributeSet::FunctionIndex,
+                                      Attribute::OptimizeForSize)) {
+    unsigned MulSize = Cpu0AnalyzeImmediate::getCost(Imm.getZExtValue()) + 1;
+    if (Steps > MulSize)
+      return SDValue();
+  } else {
+    const Cpu0InstrInfo *TII =
+      static_cast<const Cpu0InstrInfo*>(DAG.getTarget().getInstrInfo());
+    if (Steps * TII->getOpcodeLatency(Cpu0::ADDu) >=
+        TII->getOpcodeLatency(Cpu0::MUL))
+      return SDValue();
+  }
+
+  return genConstMult(N->getOperand(0), Imm, SDLoc(N), VT,
+                      TL->getShiftAmountTy(VT), DAG);
+}
+
 SDValue Cpu0TargetLowering::PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI)
   const {
   SelectionDAG &DAG = DCI.DAG;
@@ -258,6 +405,8 @@ SDValue Cpu0TargetLowering::PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI)
   case ISD::SDIVREM:
   case ISD::UDIVREM:
     return PerformDivRemCombine(N, DAG, DCI, Subtarget);
+  case ISD::MUL:
+    return PerformMULCombine(N, DAG, DCI, this);
   }
 
   return SDValue();
@@ -273,6 +422,8 @@ LowerOperation(SDValue Op, SelectionDAG &DAG) const
     case ISD::GlobalAddress:      return LowerGlobalAddress(Op, DAG);
     case ISD::GlobalTLSAddress:   return lowerGlobalTLSAddress(Op, DAG);
     case ISD::JumpTable:          return lowerJumpTable(Op, DAG);
+    case ISD::Constant:           return lowerConstant(Op, DAG);
+    case ISD::BR_JT:              return lowerBR_JT(Op, DAG);
     case ISD::SELECT:             return lowerSELECT(Op, DAG);
     case ISD::VASTART:            return LowerVASTART(Op, DAG);
     case ISD::SHL_PARTS:          return lowerShiftLeftParts(Op, DAG);
@@ -317,31 +468,36 @@ SDValue Cpu0TargetLowering::LowerGlobalAddress(SDValue Op,
                                                SelectionDAG &DAG) const {
   // FIXME there isn't actually debug info here
   SDLoc DL = SDLoc(Op);
-  const GlobalValue *GV = cast<GlobalAddressSDNode>(Op)->getGlobal();
+  const GlobalAddressSDNode *N = cast<GlobalAddressSDNode>(Op);
+  const GlobalValue *GV = N->getGlobal();
+  int64_t Offset = N->getOffset();
 
-  Cpu0TargetObjectFile &TLOF = (Cpu0TargetObjectFile&)getObjFileLowering();
+  const Cpu0TargetObjectFile &TLOF =
+    (const Cpu0TargetObjectFile&)getObjFileLowering();
 
   if (getTargetMachine().getRelocationModel() != Reloc::PIC_) {
     SDVTList VTs = DAG.getVTList(MVT::i32);
 
     // %gp_rel relocation
     if (TLOF.IsGlobalInSmallSection(GV, getTargetMachine())) {
-      SDValue GA = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, 0,
+      SDValue GA = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, Offset,
                                               Cpu0II::MO_GPREL);
       SDValue GPRelNode = DAG.getNode(Cpu0ISD::GPRel, DL, VTs, GA);
       SDValue GOT = DAG.getGLOBAL_OFFSET_TABLE(MVT::i32);
       return DAG.getNode(ISD::ADD, DL, MVT::i32, GOT, GPRelNode);
     }
     // %hi/%lo relocation
-    SDValue GAHi = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, 0,
+    SDValue GAHi = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, Offset,
                                               Cpu0II::MO_ABS_HI);
-    SDValue GALo = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, 0,
+    SDValue GALo = DAG.getTargetGlobalAddress(GV, DL, MVT::i32, Offset,
                                               Cpu0II::MO_ABS_LO);
     SDValue HiPart = DAG.getNode(Cpu0ISD::Hi, DL, VTs, GAHi);
     SDValue Lo = DAG.getNode(Cpu0ISD::Lo, DL, MVT::i32, GALo);
     return DAG.getNode(ISD::ADD, DL, MVT::i32, HiPart, Lo);
   }
 
+  assert(Offset == 0 && "Offsets are not folded into PIC addresses.");
+
   if (GV->hasInternalLinkage() || (GV->hasLocalLinkage() && !isa<Function>(GV)))
     return getAddrLocal(Op, DAG);
 
@@ -439,6 +595,103 @@ lowerJumpTable(SDValue Op, SelectionDAG &DAG) const
   return getAddrLocal(Op, DAG);
 }
 
+/// countConstantSites - Return how many basic blocks of the module use the
+/// i32 constant C, counting no further than Limit. Each block builds its
+/// constants once, so this is the number of lui/ori pairs C costs.
+static unsigned countConstantSites(const Function *F, const ConstantInt *C,
+                                   unsigned Limit) {
+  const Module *M = F->getParent();
+  SmallPtrSet<const BasicBlock*, 8> Blocks;
+  for (Value::const_user_iterator UI = C->user_begin(), UE = C->user_end();
+       UI != UE && Blocks.size() < Limit; ++UI)
+    if (const Instruction *I = dyn_cast<Instruction>(*UI))
+      if (I->getParent()->getParent()->getParent() == M)
+        Blocks.insert(I->getParent());
+  return Blocks.size();
+}
+
+// With -cpu0-gp-const-pool a 32-bit constant that needs lui/ori may be
+// loaded from the constant pool instead, which Cpu0TargetObjectFile places
+// in .sdata.cst4 so it is one $gp relative ld:
+//  ld $r, %gp_rel($CPI)($gp)
+// Per block that is 1 instruction against 2, plus one pool word that all
+// the blocks share and the linker merges across the program. When
+// optimizing for size the pool wins as soon as two blocks use the constant.
+// Otherwise the pool is only used if ld is no slower than lui/ori, or if
+// enough blocks repeat the constant to pay for the extra load latency in
+// fetched code. Only the IR uses of the constant are counted: a constant
+// that first appears during lowering (an offset, an expanded operation) has
+// no sites and stays lui/ori unless ld is no slower.
+SDValue Cpu0TargetLowering::
+lowerConstant(SDValue Op, SelectionDAG &DAG) const
+{
+  uint32_t Imm = cast<ConstantSDNode>(Op)->getZExtValue();
+  if (Cpu0AnalyzeImmediate::getCost(Imm) < 2)
+    return Op;
+
+  const Function *F = DAG.getMachineFunction().getFunction();
+  ConstantInt *C = ConstantInt::get(Type::getInt32Ty(*DAG.getContext()), Imm);
+  bool OptSize = F->getAttributes().hasAttribute(AttributeSet::FunctionIndex,
+                                                 Attribute::OptimizeForSize);
+
+  const Cpu0InstrInfo *TII =
+    static_cast<const Cpu0InstrInfo*>(getTargetMachine().getInstrInfo());
+  unsigned InlineLatency = TII->getOpcodeLatency(Cpu0::LUi) +
+                           TII->getOpcodeLatency(Cpu0::ORi);
+  unsigned PoolLatency = TII->getOpcodeLatency(Cpu0::LD);
+  if (OptSize || PoolLatency > InlineLatency) {
+    unsigned MinSites = OptSize ? 2 : (unsigned)GPConstPoolMinSites;
+    if (countConstantSites(F, C, MinSites) < MinSites)
+      return Op;
+  }
+
+  ++NumGPConstLoads;
+  SDLoc DL(Op);
+  SDValue CP = DAG.getTargetConstantPool(C, MVT::i32, 0, 0, Cpu0II::MO_GPREL);
+  SDValue GPRelNode = DAG.getNode(Cpu0ISD::GPRel, DL,
+                                  DAG.getVTList(MVT::i32), CP);
+  SDValue GOT = DAG.getGLOBAL_OFFSET_TABLE(MVT::i32);
+  SDValue Addr = DAG.getNode(ISD::ADD, DL, MVT::i32, GOT, GPRelNode);
+  return DAG.getLoad(MVT::i32, DL, DAG.getEntryNode(), Addr,
+                     MachinePointerInfo::getConstantPool(), false, false,
+                     true, 0);
+}
+
+// Jump table entries are the distance of the case block from the table,
+// which Cpu0AsmPrinter emits right after the function body. The entries need
+// no relocation, so static and PIC code share the same table, and they are
+// 16 bits wide unless the function is too large for that. The width is only
+// known once the code is final, so the entry is loaded by the LoadJTEntry
+// pseudo, which Cpu0AsmPrinter expands to a shl by 1 and lh, or a shl by 2
+// and ld:
+//  (lui/addiu or ld %got/addiu) $t, JTI
+//  shl  $e, $i, 1
+//  addu $e, $t, $e
+//  lh   $e, 0($e)
+//  add  $e, $t, $e
+//  jr   $e
+SDValue Cpu0TargetLowering::
+lowerBR_JT(SDValue Op, SelectionDAG &DAG) const
+{
+  SDLoc DL(Op);
+  SDValue Chain = Op.getOperand(0);
+  SDValue Table = Op.getOperand(1);
+  SDValue Index = Op.getOperand(2);
+  EVT PtrVT = getPointerTy();
+
+  SDValue Base = lowerJumpTable(Table, DAG);
+  SDValue Entry = DAG.getNode(Cpu0ISD::JTEntry, DL,
+                              DAG.getVTList(PtrVT, MVT::Other), Chain, Base,
+                              Index);
+  Chain = Entry.getValue(1);
+  SDValue Target = DAG.getNode(ISD::ADD, DL, PtrVT, Base, Entry);
+  return DAG.getNode(ISD::BRIND, DL, MVT::Other, Chain, Target);
+}
+
+unsigned Cpu0TargetLowering::getJumpTableEncoding() const {
+  return MachineJumpTableInfo::EK_Inline;
+}
+
 SDValue Cpu0TargetLowering::lowerShiftLeftParts(SDValue Op,
                                                 SelectionDAG &DAG) const {
   SDLoc DL(Op);
@@ -567,6 +820,91 @@ WriteByValArg(SDValue& ByValChain, SDValue Chain, SDLoc DL,
                              MachinePointerInfo(), MachinePointerInfo());
 } // lbd document - mark - WriteByValArg
 
+/// isIncomingArgAtOffset - Return true if Arg is a load of this function's
+/// own incoming stack argument at the slot VA assigns, so a tail call can
+/// leave it in place.
+static bool isIncomingArgAtOffset(SDValue Arg, const CCValAssign &VA,
+                                  const MachineFrameInfo *MFI,
+                                  const Cpu0FunctionInfo *Cpu0FI) {
+  if (VA.getLocInfo() != CCValAssign::Full)
+    return false;
+
+  LoadSDNode *Ld = dyn_cast<LoadSDNode>(Arg);
+  if (!Ld || Ld->getExtensionType() != ISD::NON_EXTLOAD)
+    return false;
+
+  FrameIndexSDNode *FINode = dyn_cast<FrameIndexSDNode>(Ld->getBasePtr());
+  if (!FINode)
+    return false;
+
+  int FI = FINode->getIndex();
+  return MFI->isFixedObjectIndex(FI) && Cpu0FI->isInArgFI(FI) &&
+         MFI->getObjectOffset(FI) == (int64_t)VA.getLocMemOffset() &&
+         MFI->getObjectSize(FI) == 4;
+}
+
+bool Cpu0TargetLowering::
+isEligibleForTailCallOptimization(const CCState &CCInfo,
+                                  const SmallVectorImpl<CCValAssign> &ArgLocs,
+                                  SDValue Callee, CallingConv::ID CalleeCC,
+                                  bool IsVarArg,
+                                  const SmallVectorImpl<ISD::OutputArg> &Outs,
+                                  const SmallVectorImpl<SDValue> &OutVals,
+                                  SelectionDAG &DAG) const {
+  MachineFunction &MF = DAG.getMachineFunction();
+  const Function *Caller = MF.getFunction();
+  const MachineFrameInfo *MFI = MF.getFrameInfo();
+  const Cpu0FunctionInfo *Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
+
+  // Varargs are always passed on the stack and va_start needs the caller's
+  // frame.
+  if (IsVarArg || Caller->isVarArg())
+    return false;
+
+  // Return conventions and callee-saved registers must agree.
+  if (Caller->getCallingConv() != CalleeCC)
+    return false;
+
+  // The sret pointer has to be returned in V0 by the caller itself.
+  if (Caller->hasStructRetAttr())
+    return false;
+
+  for (unsigned i = 0, e = Outs.size(); i != e; ++i)
+    if (Outs[i].Flags.isByVal() || Outs[i].Flags.isSRet())
+      return false;
+
+  // In PIC mode, and for indirect calls, the jump goes through T9 so that
+  // the callee's .cpload can rebuild $gp. T9 must not carry an argument.
+  bool IsPIC = getTargetMachine().getRelocationModel() == Reloc::PIC_;
+  bool IsDirect = isa<GlobalAddressSDNode>(Callee) ||
+                  isa<ExternalSymbolSDNode>(Callee);
+  for (unsigned i = 0, e = ArgLocs.size(); i != e; ++i)
+    if (ArgLocs[i].isRegLoc() && ArgLocs[i].getLocReg() == Cpu0::T9 &&
+        (IsPIC || !IsDirect))
+      return false;
+
+  // Stack arguments are written into the caller's incoming argument area.
+  // A guaranteed fastcc tail call may store anywhere inside that area; a
+  // sibling call may only pass on arguments already in the right slot.
+  if (CCInfo.getNextStackOffset() > Cpu0FI->getIncomingArgSize())
+    return false;
+
+  if (getTargetMachine().Options.GuaranteedTailCallOpt &&
+      CalleeCC == CallingConv::Fast)
+    return true;
+
+  for (unsigned i = 0, e = ArgLocs.size(); i != e; ++i)
+    if (ArgLocs[i].isMemLoc() &&
+        !isIncomingArgAtOffset(OutVals[i], ArgLocs[i], MFI, Cpu0FI))
+      return false;
+
+  return true;
+}
+
+bool Cpu0TargetLowering::mayBeEmittedAsTailCall(CallInst *CI) const {
+  return CI->isTailCall() && !getTargetMachine().Options.DisableTailCalls;
+}
+
 // lbd document - mark - before LowerCall
 SDValue
 Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
@@ -581,8 +919,9 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   bool &isTailCall                      = CLI.IsTailCall;
   CallingConv::ID CallConv              = CLI.CallConv;
   bool isVarArg                         = CLI.IsVarArg;
-  // Cpu0 target does not yet support tail call optimization.
-  isTailCall                            = false;
+
+  if (getTargetMachine().Options.DisableTailCalls)
+    isTailCall = false;
 
   MachineFunction &MF = DAG.getMachineFunction();
   MachineFrameInfo *MFI = MF.getFrameInfo();
@@ -600,16 +939,33 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   // Get a count of how many bytes are to be pushed on the stack.
   unsigned NextStackOffset = CCInfo.getNextStackOffset();
 
+  // Check if it's really possible to do a tail call.
+  if (isTailCall)
+    isTailCall = isEligibleForTailCallOptimization(CCInfo, ArgLocs, Callee,
+                                                   CallConv, isVarArg, Outs,
+                                                   OutVals, DAG);
+
+  if (!isTailCall && CLI.CS && CLI.CS->isMustTailCall())
+    report_fatal_error("failed to perform tail call elimination on a call "
+                       "site marked musttail");
+
+  if (isTailCall)
+    ++NumTailCalls;
+
   // If this is the first call, create a stack frame object that points to
-  // a location to which .cprestore saves $gp.
-  if (IsPIC && Cpu0FI->globalBaseRegFixed() && !Cpu0FI->getGPFI())
+  // a location to which .cprestore saves $gp. A tail call never returns
+  // here, so $gp need not be restored after it.
+  if (IsPIC && Cpu0FI->globalBaseRegFixed() && !Cpu0FI->getGPFI() &&
+      !isTailCall)
     Cpu0FI->setGPFI(MFI->CreateFixedObject(4, 0, true));
   // Get the frame index of the stack frame object that points to the location
   // of dynamically allocated area on the stack.
   int DynAllocFI = Cpu0FI->getDynAllocFI();
   unsigned MaxCallFrameSize = Cpu0FI->getMaxCallFrameSize();
 
-  if (MaxCallFrameSize < NextStackOffset) {
+  // The stack arguments of a tail call go into our own incoming area, so
+  // they do not grow the outgoing call frame.
+  if (!isTailCall && MaxCallFrameSize < NextStackOffset) {
     Cpu0FI->setMaxCallFrameSize(NextStackOffset);
 
     // Set the offsets relative to $sp of the $gp restore slot and dynamically
@@ -629,7 +985,11 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   // byval arguments to the stack.
   SDValue Chain, CallSeqStart, ByValChain;
   SDValue NextStackOffsetVal = DAG.getIntPtrConstant(NextStackOffset, true);
-  Chain = CallSeqStart = DAG.getCALLSEQ_START(InChain, NextStackOffsetVal, DL);
+  if (isTailCall)
+    Chain = InChain;
+  else
+    Chain = CallSeqStart = DAG.getCALLSEQ_START(InChain, NextStackOffsetVal,
+                                                DL);
   ByValChain = InChain;
 
   // With EABI is it possible to have 16 args on registers.
@@ -681,6 +1041,23 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
     // Register can't get to this point...
     assert(VA.isMemLoc());
 
+    if (isTailCall) {
+      // The argument already sits in our own incoming slot.
+      if (isIncomingArgAtOffset(Arg, VA, MFI, Cpu0FI))
+        continue;
+
+      // Store it over our incoming arguments, after all of them have been
+      // loaded. The object is not recorded as an outgoing argument, so it
+      // is addressed relative to the caller's $sp.
+      int FI = MFI->CreateFixedObject(ValVT.getSizeInBits()/8,
+                                      VA.getLocMemOffset(), false);
+      SDValue PtrOff = DAG.getFrameIndex(FI, getPointerTy());
+      MemOpChains.push_back(
+        DAG.getStore(DAG.getStackArgumentTokenFactor(Chain), DL, Arg, PtrOff,
+                     MachinePointerInfo::getFixedStack(FI), false, false, 0));
+      continue;
+    }
+
     // Create the frame index object for this incoming parameter
     LastFI = MFI->CreateFixedObject(ValVT.getSizeInBits()/8,
                                     VA.getLocMemOffset(), true);
@@ -743,7 +1120,7 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
                            getGlobalReg(DAG, getPointerTy()), Callee);
       SDValue LoadValue = DAG.getLoad(getPointerTy(), DL, DAG.getEntryNode(),
                                       Callee, MachinePointerInfo::getGOT(),
-                                      false, false, false, 0);
+                                      false, false, true, 0);
 
       // Use GOT+LO if callee has internal linkage.
       if (CalleeLo.getNode()) {
@@ -755,8 +1132,12 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   }
 
   // T9 should contain the address of the callee function if
-  // -reloction-model=pic or it is an indirect call.
-  if (IsPICCall || !GlobalOrExternal) {
+  // -reloction-model=pic or it is an indirect call. T9 may carry an argument
+  // with -cpu0-reg-args, so static indirect calls then jump through any
+  // register. Indirect tail calls always use T9, which is not restored by
+  // the epilogue; isEligibleForTailCallOptimization keeps it free.
+  if (IsPICCall ||
+      (!GlobalOrExternal && (!Subtarget->useRegArgs() || isTailCall))) {
     // copy to T9
     unsigned T9Reg = Cpu0::T9;
     Chain = DAG.getCopyToReg(Chain, DL, T9Reg, Callee, SDValue(0, 0));
@@ -764,6 +1145,16 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
     Callee = DAG.getRegister(T9Reg, getPointerTy());
   }
 
+  // Build a sequence of copy-to-reg nodes chained together with token
+  // chain and flag operands which copy the outgoing args into registers.
+  // The InFlag is necessary since all emitted instructions must be
+  // stuck together.
+  for (unsigned i = 0, e = RegsToPass.size(); i != e; ++i) {
+    Chain = DAG.getCopyToReg(Chain, DL, RegsToPass[i].first,
+                             RegsToPass[i].second, InFlag);
+    InFlag = Chain.getValue(1);
+  }
+
   // Cpu0JmpLink = #chain, #target_address, #opt_in_flags...
   //             = Chain, Callee, Reg#1, Reg#2, ...
   //
@@ -788,6 +1179,9 @@ Cpu0TargetLowering::LowerCall(TargetLowering::CallLoweringInfo &CLI,
   if (InFlag.getNode())
     Ops.push_back(InFlag);
 
+  if (isTailCall)
+    return DAG.getNode(Cpu0ISD::TailCall, DL, MVT::Other, Ops);
+
   Chain  = DAG.getNode(Cpu0ISD::JmpLink, DL, NodeTys, Ops);
   InFlag = Chain.getValue(1);
 
@@ -883,6 +1277,13 @@ Cpu0TargetLowering::LowerFormalArguments(SDValue Chain,
                          
   CCInfo.AnalyzeFormalArguments(Ins, CC_Cpu0);
 
+  Cpu0FI->setIncomingArgSize(CCInfo.getNextStackOffset());
+
+  // A guaranteed fastcc tail call may overwrite the incoming arguments, so
+  // they must not be treated as immutable.
+  bool ImmutableArgs = !(getTargetMachine().Options.GuaranteedTailCallOpt &&
+                         CallConv == CallingConv::Fast);
+
   Function::const_arg_iterator FuncArg =
     DAG.getMachineFunction().getFunction()->arg_begin();
   int LastFI = 0;// Cpu0FI->LastInArgFI is 0 at the entry of this function.
@@ -900,8 +1301,41 @@ Cpu0TargetLowering::LowerFormalArguments(SDValue Chain,
                                       true);
       SDValue FIN = DAG.getFrameIndex(LastFI, getPointerTy());
       InVals.push_back(FIN);
-      ReadByValArg(MF, Chain, DL, OutChains, DAG, NumWords, FIN, VA, Flags,
-                   &*FuncArg);
+      // With -cpu0-reg-args the argument registers hold scalar arguments
+      // and byval aggregates live entirely on the stack.
+      if (!Subtarget->useRegArgs())
+        ReadByValArg(MF, Chain, DL, OutChains, DAG, NumWords, FIN, VA, Flags,
+                     &*FuncArg);
+      continue;
+    }
+
+    // Arguments stored on registers
+    if (VA.isRegLoc()) {
+      EVT RegVT = VA.getLocVT();
+      unsigned ArgReg = VA.getLocReg();
+      const TargetRegisterClass *RC = getRegClassFor(RegVT.getSimpleVT());
+
+      // Transform the arguments stored on
+      // physical registers into virtual ones
+      unsigned Reg = AddLiveIn(MF, ArgReg, RC);
+      SDValue ArgValue = DAG.getCopyFromReg(Chain, DL, Reg, RegVT);
+
+      // If this is an 8 or 16-bit value, it has been passed promoted
+      // to 32 bits.  Insert an assert[sz]ext to capture this, then
+      // truncate to the right size.
+      if (VA.getLocInfo() != CCValAssign::Full) {
+        unsigned Opcode = 0;
+        if (VA.getLocInfo() == CCValAssign::SExt)
+          Opcode = ISD::AssertSext;
+        else if (VA.getLocInfo() == CCValAssign::ZExt)
+          Opcode = ISD::AssertZext;
+        if (Opcode)
+          ArgValue = DAG.getNode(Opcode, DL, RegVT, ArgValue,
+                                 DAG.getValueType(ValVT));
+        ArgValue = DAG.getNode(ISD::TRUNCATE, DL, ValVT, ArgValue);
+      }
+
+      InVals.push_back(ArgValue);
       continue;
     }
 
@@ -910,7 +1344,7 @@ Cpu0TargetLowering::LowerFormalArguments(SDValue Chain,
 
     // The stack pointer offset is relative to the caller stack frame.
     LastFI = MFI->CreateFixedObject(ValVT.getSizeInBits()/8,
-                                    VA.getLocMemOffset(), true);
+                                    VA.getLocMemOffset(), ImmutableArgs);
 
     // Create load nodes to retrieve arguments from the stack
     SDValue FIN = DAG.getFrameIndex(LastFI, getPointerTy());
@@ -1282,7 +1716,10 @@ bool Cpu0TargetLowering::isLegalAddressingMode(const AddrMode &AM,
 
 bool // lbd document - mark - isOffsetFoldingLegal
 Cpu0TargetLowering::isOffsetFoldingLegal(const GlobalAddressSDNode *GA) const {
-  // The Cpu0 target isn't yet aware of offsets.
-  return false;
+  // In static mode the offset is carried by the %hi/%lo and %gp_rel
+  // relocations, so (add GA, C) can become a single GA with an offset.
+  // A GOT entry holds the address of the symbol itself, so the PIC
+  // sequences keep the offset as a separate add.
+  return getTargetMachine().getRelocationModel() != Reloc::PIC_;
 }
 
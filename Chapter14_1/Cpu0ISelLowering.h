@@ -17,6 +17,7 @@
 
 #include "Cpu0.h"
 #include "Cpu0Subtarget.h"
+#include "llvm/CodeGen/CallingConvLower.h"
 #include "llvm/CodeGen/SelectionDAG.h"
 #include "llvm/Target/TargetLowering.h"
 
@@ -29,6 +30,9 @@ namespace llvm {
       // Jump and link (call)
       JmpLink,
 
+      // Tail call
+      TailCall,
+
       // Get the Higher 16 bits from a 32-bit immediate
       // No relation with Cpu0 Hi register
       Hi,
@@ -48,6 +52,10 @@ namespace llvm {
 
       Wrapper,
       DynAlloc,
+
+      // Load the entry of a jump table, see lowerBR_JT.
+      JTEntry,
+
       Sync
     };
   }
@@ -70,6 +78,14 @@ namespace llvm {
 
     virtual SDValue PerformDAGCombine(SDNode *N, DAGCombinerInfo &DCI) const;
 
+    /// mayBeEmittedAsTailCall - Return true if the target may be able to
+    /// emit the call instruction as a tail call.
+    virtual bool mayBeEmittedAsTailCall(CallInst *CI) const;
+
+    /// getJumpTableEncoding - Jump tables are emitted by Cpu0AsmPrinter at
+    /// the end of the function as label differences from the table.
+    virtual unsigned getJumpTableEncoding() const;
+
   protected:
     SDValue getGlobalReg(SelectionDAG &DAG, EVT Ty) const;
 
@@ -91,12 +107,22 @@ namespace llvm {
                             SDLoc DL, SelectionDAG &DAG,
                             SmallVectorImpl<SDValue> &InVals) const;
 
+    /// isEligibleForTailCallOptimization - Check whether the call is eligible
+    /// for tail call optimization.
+    bool isEligibleForTailCallOptimization(
+      const CCState &CCInfo, const SmallVectorImpl<CCValAssign> &ArgLocs,
+      SDValue Callee, CallingConv::ID CalleeCC, bool IsVarArg,
+      const SmallVectorImpl<ISD::OutputArg> &Outs,
+      const SmallVectorImpl<SDValue> &OutVals, SelectionDAG &DAG) const;
+
     // Lower Operand specifics
     SDValue LowerBRCOND(SDValue Op, SelectionDAG &DAG) const;
     SDValue lowerSELECT(SDValue Op, SelectionDAG &DAG) const;
     SDValue LowerGlobalAddress(SDValue Op, SelectionDAG &DAG) const;
     SDValue lowerGlobalTLSAddress(SDValue Op, SelectionDAG &DAG) const;
     SDValue lowerJumpTable(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerConstant(SDValue Op, SelectionDAG &DAG) const;
+    SDValue lowerBR_JT(SDValue Op, SelectionDAG &DAG) const;
     SDValue LowerVASTART(SDValue Op, SelectionDAG &DAG) const;
 
     SDValue lowerShiftLeftParts(SDValue Op, SelectionDAG& DAG) const;
@@ -14,7 +14,9 @@
 #include "Cpu0InstrInfo.h"
 #include "Cpu0TargetMachine.h"
 #include "Cpu0MachineFunction.h"
+#include "MCTargetDesc/Cpu0BaseInfo.h"
 #include "llvm/CodeGen/MachineInstrBuilder.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
 #define GET_INSTRINFO_CTOR_DTOR
 #include "Cpu0GenInstrInfo.inc"
 
@@ -30,6 +32,436 @@ const Cpu0RegisterInfo &Cpu0InstrInfo::getRegisterInfo() const {
   return RI;
 } // lbd document - mark - getRegisterInfo()
 
+//===----------------------------------------------------------------------===//
+// Branch Analysis
+//===----------------------------------------------------------------------===//
+
+/// GetAnalyzableBrOpc - Return Opc if it is a branch AnalyzeBranch can handle,
+/// otherwise return 0.
+unsigned Cpu0InstrInfo::GetAnalyzableBrOpc(unsigned Opc) const {
+  return (Opc == Cpu0::JMP ||
+          Opc == Cpu0::JEQ || Opc == Cpu0::JNE ||
+          Opc == Cpu0::JLT || Opc == Cpu0::JGT ||
+          Opc == Cpu0::JLE || Opc == Cpu0::JGE ||
+          Opc == Cpu0::BEQ || Opc == Cpu0::BNE) ? Opc : 0;
+}
+
+/// GetOppositeBranchOpc - Return the inverse of the specified
+/// conditional branch opcode.
+unsigned Cpu0InstrInfo::GetOppositeBranchOpc(unsigned Opc) const {
+  switch (Opc) {
+  default:           llvm_unreachable("Illegal opcode!");
+  case Cpu0::JEQ:    return Cpu0::JNE;
+  case Cpu0::JNE:    return Cpu0::JEQ;
+  case Cpu0::JLT:    return Cpu0::JGE;
+  case Cpu0::JGE:    return Cpu0::JLT;
+  case Cpu0::JGT:    return Cpu0::JLE;
+  case Cpu0::JLE:    return Cpu0::JGT;
+  case Cpu0::BEQ:    return Cpu0::BNE;
+  case Cpu0::BNE:    return Cpu0::BEQ;
+  }
+}
+
+// The condition is kept as the branch opcode followed by the register
+// operands: (Opc, $sw) for JEQ..JGE and (Opc, $ra, $rb) for BEQ/BNE.
+void Cpu0InstrInfo::AnalyzeCondBr(const MachineInstr *Inst, unsigned Opc,
+                                  MachineBasicBlock *&BB,
+                                  SmallVectorImpl<MachineOperand> &Cond) const {
+  assert(GetAnalyzableBrOpc(Opc) && "Not an analyzable branch");
+  int NumOp = Inst->getNumExplicitOperands();
+
+  // The last explicit operand is the MBB.
+  BB = Inst->getOperand(NumOp-1).getMBB();
+  Cond.push_back(MachineOperand::CreateImm(Opc));
+
+  for (int i=0; i<NumOp-1; i++)
+    Cond.push_back(Inst->getOperand(i));
+}
+
+bool Cpu0InstrInfo::AnalyzeBranch(MachineBasicBlock &MBB,
+                                  MachineBasicBlock *&TBB,
+                                  MachineBasicBlock *&FBB,
+                                  SmallVectorImpl<MachineOperand> &Cond,
+                                  bool AllowModify) const {
+  MachineBasicBlock::reverse_iterator I = MBB.rbegin(), REnd = MBB.rend();
+
+  // Skip all the debug instructions.
+  while (I != REnd && I->isDebugValue())
+    ++I;
+
+  if (I == REnd || !isUnpredicatedTerminator(&*I)) {
+    // This block ends with no branches (it just falls through to its succ).
+    // Leave TBB/FBB null.
+    TBB = FBB = nullptr;
+    return false;
+  }
+
+  MachineInstr *LastInst = &*I;
+  unsigned LastOpc = LastInst->getOpcode();
+
+  // Not an analyzable branch (must be an indirect jump).
+  if (!GetAnalyzableBrOpc(LastOpc))
+    return true;
+
+  // Get the second to last instruction in the block.
+  unsigned SecondLastOpc = 0;
+  MachineInstr *SecondLastInst = nullptr;
+
+  if (++I != REnd) {
+    SecondLastInst = &*I;
+    SecondLastOpc = GetAnalyzableBrOpc(SecondLastInst->getOpcode());
+
+    // Not an analyzable branch (must be an indirect jump).
+    if (isUnpredicatedTerminator(SecondLastInst) && !SecondLastOpc)
+      return true;
+  }
+
+  // If there is only one terminator instruction, process it.
+  if (!SecondLastOpc) {
+    // Unconditional branch
+    if (LastOpc == Cpu0::JMP) {
+      TBB = LastInst->getOperand(0).getMBB();
+      return false;
+    }
+
+    // Conditional branch
+    AnalyzeCondBr(LastInst, LastOpc, TBB, Cond);
+    return false;
+  }
+
+  // If we reached here, there are two branches.
+  // If there are three terminators, we don't know what sort of block this is.
+  if (++I != REnd && isUnpredicatedTerminator(&*I))
+    return true;
+
+  // If second to last instruction is an unconditional branch,
+  // analyze it and remove the last instruction.
+  if (SecondLastOpc == Cpu0::JMP) {
+    // Return if the last instruction cannot be removed.
+    if (!AllowModify)
+      return true;
+
+    TBB = SecondLastInst->getOperand(0).getMBB();
+    LastInst->eraseFromParent();
+    return false;
+  }
+
+  // Conditional branch followed by an unconditional branch.
+  // The last one must be unconditional.
+  if (LastOpc != Cpu0::JMP)
+    return true;
+
+  AnalyzeCondBr(SecondLastInst, SecondLastOpc, TBB, Cond);
+  FBB = LastInst->getOperand(0).getMBB();
+
+  return false;
+}
+
+void Cpu0InstrInfo::BuildCondBr(MachineBasicBlock &MBB,
+                                MachineBasicBlock *TBB, DebugLoc DL,
+                                const SmallVectorImpl<MachineOperand> &Cond)
+  const {
+  unsigned Opc = Cond[0].getImm();
+  const MCInstrDesc &MCID = get(Opc);
+  MachineInstrBuilder MIB = BuildMI(&MBB, DL, MCID);
+
+  for (unsigned i = 1; i < Cond.size(); ++i) {
+    if (Cond[i].isReg())
+      MIB.addReg(Cond[i].getReg());
+    else if (Cond[i].isImm())
+      MIB.addImm(Cond[i].getImm());
+    else
+      llvm_unreachable("Cannot copy operand");
+  }
+  MIB.addMBB(TBB);
+}
+
+unsigned Cpu0InstrInfo::
+InsertBranch(MachineBasicBlock &MBB, MachineBasicBlock *TBB,
+             MachineBasicBlock *FBB,
+             const SmallVectorImpl<MachineOperand> &Cond,
+             DebugLoc DL) const {
+  // Shouldn't be a fall through.
+  assert(TBB && "InsertBranch must not be told to insert a fallthrough");
+
+  // # of condition operands:
+  //  Unconditional branches: 0
+  //  JEQ..JGE: 2 (opc, $sw)
+  //  BEQ/BNE: 3 (opc, $ra, $rb)
+  assert((Cond.size() <= 3) &&
+         "# of Cpu0 branch conditions must be <= 3!");
+
+  // Two-way Conditional branch.
+  if (FBB) {
+    BuildCondBr(MBB, TBB, DL, Cond);
+    BuildMI(&MBB, DL, get(Cpu0::JMP)).addMBB(FBB);
+    return 2;
+  }
+
+  // One way branch.
+  // Unconditional branch.
+  if (Cond.empty())
+    BuildMI(&MBB, DL, get(Cpu0::JMP)).addMBB(TBB);
+  else // Conditional branch.
+    BuildCondBr(MBB, TBB, DL, Cond);
+  return 1;
+}
+
+unsigned Cpu0InstrInfo::RemoveBranch(MachineBasicBlock &MBB) const {
+  MachineBasicBlock::reverse_iterator I = MBB.rbegin(), REnd = MBB.rend();
+  MachineBasicBlock::reverse_iterator FirstBr;
+  unsigned removed;
+
+  // Skip all the debug instructions.
+  while (I != REnd && I->isDebugValue())
+    ++I;
+
+  FirstBr = I;
+
+  // Up to 2 branches are removed.
+  // Note that indirect branches are not removed.
+  for (removed = 0; I != REnd && removed < 2; ++I, ++removed)
+    if (!GetAnalyzableBrOpc(I->getOpcode()))
+      break;
+
+  MBB.erase(I.base(), FirstBr.base());
+
+  return removed;
+}
+
+/// ReverseBranchCondition - Return the inverse opcode of the
+/// specified Branch instruction.
+bool Cpu0InstrInfo::
+ReverseBranchCondition(SmallVectorImpl<MachineOperand> &Cond) const {
+  assert( (Cond.size() && Cond.size() <= 3) &&
+          "Invalid Cpu0 branch condition!");
+  Cond[0].setImm(GetOppositeBranchOpc(Cond[0].getImm()));
+  return false;
+}
+
+unsigned Cpu0InstrInfo::getOpcodeLatency(unsigned Opc) const {
+  const InstrItineraryData *Itins = TM.getInstrItineraryData();
+  if (!Itins || Itins->isEmpty())
+    return 1;
+
+  unsigned SchedClass = get(Opc).getSchedClass();
+  int Latency = Itins->getOperandCycle(SchedClass, 0);
+  return Latency > 0 ? Latency : Itins->getStageLatency(SchedClass);
+}
+
+//===----------------------------------------------------------------------===//
+// If-conversion
+//===----------------------------------------------------------------------===//
+
+/// canInsertSelect - A phi of two general registers becomes a movz or movn
+/// on the register insertSelect derives from the branch condition. That is
+/// an xor for beq/bne (nothing against $zero), or mfsw and andi for the
+/// branches on the flags of cmp.
+bool Cpu0InstrInfo::
+canInsertSelect(const MachineBasicBlock &MBB,
+                const SmallVectorImpl<MachineOperand> &Cond,
+                unsigned TrueReg, unsigned FalseReg,
+                int &CondCycles, int &TrueCycles, int &FalseCycles) const {
+  if (Cond.size() < 2)
+    return false;
+
+  const MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+  const TargetRegisterClass *RC =
+    RI.getCommonSubClass(MRI.getRegClass(TrueReg), MRI.getRegClass(FalseReg));
+  if (!RC || !Cpu0::CPURegsRegClass.hasSubClassEq(RC))
+    return false;
+
+  unsigned Opc = Cond[0].getImm();
+  if (Opc == Cpu0::BEQ || Opc == Cpu0::BNE)
+    CondCycles = Cond[2].getReg() == Cpu0::ZERO ? 0 :
+                 getOpcodeLatency(Cpu0::XOR);
+  else
+    CondCycles = getOpcodeLatency(Cpu0::MFSW) +
+                 getOpcodeLatency(Cpu0::ANDi);
+
+  // movz/movn read both values.
+  TrueCycles = FalseCycles = getOpcodeLatency(Cpu0::MOVZ_I_I);
+  return true;
+}
+
+/// insertSelect - DstReg = Cond ? TrueReg : FalseReg. movz moves TrueReg
+/// when the condition register is zero, movn when it is not; otherwise
+/// DstReg keeps FalseReg, which is tied to it.
+void Cpu0InstrInfo::
+insertSelect(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+             DebugLoc DL, unsigned DstReg,
+             const SmallVectorImpl<MachineOperand> &Cond,
+             unsigned TrueReg, unsigned FalseReg) const {
+  MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+  unsigned Opc = Cond[0].getImm();
+  unsigned CondReg, MovOpc;
+
+  if (Opc == Cpu0::BEQ || Opc == Cpu0::BNE) {
+    // $ra == $rb is the same as ($ra ^ $rb) == 0.
+    CondReg = Cond[1].getReg();
+    if (Cond[2].getReg() != Cpu0::ZERO) {
+      CondReg = MRI.createVirtualRegister(&Cpu0::CPURegsRegClass);
+      BuildMI(MBB, I, DL, get(Cpu0::XOR), CondReg)
+        .addReg(Cond[1].getReg()).addReg(Cond[2].getReg());
+    }
+    MovOpc = (Opc == Cpu0::BEQ) ? Cpu0::MOVZ_I_I : Cpu0::MOVN_I_I;
+  } else {
+    // Bit 0 of $sw is set when $ra < $rb, bit 1 when $ra == $rb.
+    unsigned Mask;
+    switch (Opc) {
+    default: llvm_unreachable("Unexpected branch condition!");
+    case Cpu0::JEQ: Mask = 2; MovOpc = Cpu0::MOVN_I_I; break;
+    case Cpu0::JNE: Mask = 2; MovOpc = Cpu0::MOVZ_I_I; break;
+    case Cpu0::JLT: Mask = 1; MovOpc = Cpu0::MOVN_I_I; break;
+    case Cpu0::JGE: Mask = 1; MovOpc = Cpu0::MOVZ_I_I; break;
+    case Cpu0::JLE: Mask = 3; MovOpc = Cpu0::MOVN_I_I; break;
+    case Cpu0::JGT: Mask = 3; MovOpc = Cpu0::MOVZ_I_I; break;
+    }
+    unsigned FlagReg = MRI.createVirtualRegister(&Cpu0::CPURegsRegClass);
+    BuildMI(MBB, I, DL, get(TargetOpcode::COPY), FlagReg)
+      .addReg(Cond[1].getReg());
+    CondReg = MRI.createVirtualRegister(&Cpu0::CPURegsRegClass);
+    BuildMI(MBB, I, DL, get(Cpu0::ANDi), CondReg)
+      .addReg(FlagReg, RegState::Kill).addImm(Mask);
+  }
+
+  BuildMI(MBB, I, DL, get(MovOpc), DstReg)
+    .addReg(TrueReg).addReg(CondReg).addReg(FalseReg);
+}
+
+//===----------------------------------------------------------------------===//
+// Compare optimization
+//===----------------------------------------------------------------------===//
+
+unsigned Cpu0InstrInfo::GetSwappedBranchOpc(unsigned Opc) const {
+  switch (Opc) {
+  default:           return 0;
+  case Cpu0::JEQ:    return Cpu0::JEQ;
+  case Cpu0::JNE:    return Cpu0::JNE;
+  case Cpu0::JLT:    return Cpu0::JGT;
+  case Cpu0::JGT:    return Cpu0::JLT;
+  case Cpu0::JLE:    return Cpu0::JGE;
+  case Cpu0::JGE:    return Cpu0::JLE;
+  }
+}
+
+/// analyzeCompare - cmp $sw, $ra, $rb compares two registers; there is no
+/// compare with an immediate.
+bool Cpu0InstrInfo::analyzeCompare(const MachineInstr *MI, unsigned &SrcReg,
+                                   unsigned &SrcReg2, int &CmpMask,
+                                   int &CmpValue) const {
+  if (MI->getOpcode() != Cpu0::CMP)
+    return false;
+
+  SrcReg = MI->getOperand(1).getReg();
+  SrcReg2 = MI->getOperand(2).getReg();
+  CmpMask = ~0;
+  CmpValue = 0;
+  return true;
+}
+
+/// writesFlags - Return true if MI writes $sw or a value of the SR class,
+/// which can only live in $sw.
+static bool writesFlags(const MachineInstr *MI, const MachineRegisterInfo *MRI,
+                        const TargetRegisterInfo *TRI) {
+  if (MI->isCall() || MI->modifiesRegister(Cpu0::SW, TRI))
+    return true;
+
+  for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
+    const MachineOperand &MO = MI->getOperand(i);
+    if (MO.isReg() && MO.isDef() &&
+        TargetRegisterInfo::isVirtualRegister(MO.getReg()) &&
+        MRI->getRegClass(MO.getReg()) == &Cpu0::SRRegClass)
+      return true;
+  }
+  return false;
+}
+
+/// optimizeCompareInstr - Remove CmpInstr if the flags it computes are still
+/// in $sw from an earlier cmp of the same registers, either in this block or
+/// in a chain of single predecessors, which dominate it. If the earlier cmp
+/// has its operands swapped, the branches on CmpInstr are swapped as well
+/// (jlt <-> jgt, jle <-> jge). The search stops at any other write of the
+/// flags, since keeping two flag values live would make the allocator spill
+/// $sw. This runs on SSA form, where equal virtual registers hold equal
+/// values.
+bool Cpu0InstrInfo::
+optimizeCompareInstr(MachineInstr *CmpInstr, unsigned SrcReg, unsigned SrcReg2,
+                     int CmpMask, int CmpValue,
+                     const MachineRegisterInfo *MRI) const {
+  unsigned FlagReg = CmpInstr->getOperand(0).getReg();
+  if (!MRI->isSSA() || !TargetRegisterInfo::isVirtualRegister(FlagReg))
+    return false;
+
+  // A physical register other than $zero may be redefined in between.
+  if ((!TargetRegisterInfo::isVirtualRegister(SrcReg) && SrcReg != Cpu0::ZERO)
+      || (!TargetRegisterInfo::isVirtualRegister(SrcReg2) &&
+          SrcReg2 != Cpu0::ZERO))
+    return false;
+
+  MachineBasicBlock *MBB = CmpInstr->getParent();
+  MachineBasicBlock::iterator I = CmpInstr;
+  MachineInstr *Earlier = 0;
+  while (!Earlier) {
+    if (I == MBB->begin()) {
+      if (MBB->pred_size() != 1)
+        return false;
+      MBB = *MBB->pred_begin();
+      if (MBB == CmpInstr->getParent())
+        return false;
+      I = MBB->end();
+      continue;
+    }
+
+    --I;
+    if (I->getOpcode() == Cpu0::CMP)
+      Earlier = I;
+    else if (writesFlags(I, MRI, &RI))
+      return false;
+  }
+
+  unsigned EarlierFlagReg = Earlier->getOperand(0).getReg();
+  if (!TargetRegisterInfo::isVirtualRegister(EarlierFlagReg))
+    return false;
+
+  bool Swapped;
+  if (Earlier->getOperand(1).getReg() == SrcReg &&
+      Earlier->getOperand(2).getReg() == SrcReg2)
+    Swapped = false;
+  else if (Earlier->getOperand(1).getReg() == SrcReg2 &&
+           Earlier->getOperand(2).getReg() == SrcReg)
+    Swapped = true;
+  else
+    return false;
+
+  // Only the branches can be rewritten for swapped operands; the flags read
+  // by setcc are fixed bits.
+  SmallVector<MachineOperand*, 4> Uses;
+  for (MachineRegisterInfo::use_iterator UI = MRI->use_begin(FlagReg),
+       UE = MRI->use_end(); UI != UE; ++UI) {
+    MachineInstr *UseMI = UI->getParent();
+    if (Swapped && !UseMI->isDebugValue() &&
+        !GetSwappedBranchOpc(UseMI->getOpcode()))
+      return false;
+    Uses.push_back(&*UI);
+  }
+
+  for (unsigned i = 0, e = Uses.size(); i != e; ++i) {
+    MachineInstr *UseMI = Uses[i]->getParent();
+    if (Swapped && !UseMI->isDebugValue())
+      UseMI->setDesc(get(GetSwappedBranchOpc(UseMI->getOpcode())));
+    Uses[i]->setReg(EarlierFlagReg);
+  }
+
+  // The earlier flags now live further.
+  for (MachineRegisterInfo::use_iterator UI = MRI->use_begin(EarlierFlagReg),
+       UE = MRI->use_end(); UI != UE; ++UI)
+    UI->setIsKill(false);
+
+  CmpInstr->eraseFromParent();
+  return true;
+}
+
 void Cpu0InstrInfo::
 copyPhysReg(MachineBasicBlock &MBB,
             MachineBasicBlock::iterator I, DebugLoc DL,
@@ -44,12 +476,16 @@ copyPhysReg(MachineBasicBlock &MBB,
       Opc = Cpu0::MFHI, SrcReg = 0;
     else if (SrcReg == Cpu0::LO)
       Opc = Cpu0::MFLO, SrcReg = 0;
+    else if (SrcReg == Cpu0::SW)
+      Opc = Cpu0::MFSW, SrcReg = 0;
   }
   else if (Cpu0::CPURegsRegClass.contains(SrcReg)) { // Copy from CPU Reg.
     if (DestReg == Cpu0::HI)
       Opc = Cpu0::MTHI, DestReg = 0;
     else if (DestReg == Cpu0::LO)
       Opc = Cpu0::MTLO, DestReg = 0;
+    else if (DestReg == Cpu0::SW)
+      Opc = Cpu0::MTSW, DestReg = 0;
   }
 
   assert(Opc && "Cannot copy registers");
@@ -88,6 +524,14 @@ storeRegToStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
 
   unsigned Opc = 0;
 
+  // ld/st only take general registers, so the flags go through $at.
+  if (RC == &Cpu0::SRRegClass) {
+    BuildMI(MBB, I, DL, get(Cpu0::MFSW), Cpu0::AT)
+      .addReg(SrcReg, RegState::Implicit | getKillRegState(isKill));
+    SrcReg = Cpu0::AT;
+    isKill = true;
+  }
+
   Opc = Cpu0::ST;
   assert(Opc && "Register class not handled!");
   BuildMI(MBB, I, DL, get(Opc)).addReg(SrcReg, getKillRegState(isKill))
@@ -107,10 +551,115 @@ loadRegFromStackSlot(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
 
   Opc = Cpu0::LD;
   assert(Opc && "Register class not handled!");
+  if (RC == &Cpu0::SRRegClass) {
+    BuildMI(MBB, I, DL, get(Opc), Cpu0::AT).addFrameIndex(FI).addImm(0)
+      .addMemOperand(MMO);
+    BuildMI(MBB, I, DL, get(Cpu0::MTSW)).addReg(Cpu0::AT, RegState::Kill)
+      .addReg(DestReg, RegState::ImplicitDefine);
+    return;
+  }
   BuildMI(MBB, I, DL, get(Opc), DestReg).addFrameIndex(FI).addImm(0)
     .addMemOperand(MMO);
 } // lbd document - mark - loadRegFromStackSlot
 
+/// isFrameAccess - Return true if MI accesses a stack slot at offset 0, as
+/// the spill code does, and set FrameIndex.
+static bool isFrameAccess(const MachineInstr *MI, int &FrameIndex) {
+  if (MI->getOperand(1).isFI() && MI->getOperand(2).isImm() &&
+      MI->getOperand(2).getImm() == 0) {
+    FrameIndex = MI->getOperand(1).getIndex();
+    return true;
+  }
+  return false;
+}
+
+// Only the word accesses are reported. StackSlotColoring and the spiller
+// take a reported load and store of the same slot and register as a no-op
+// round trip, which is not true of lb/sb or lh/sh.
+unsigned Cpu0InstrInfo::isLoadFromStackSlot(const MachineInstr *MI,
+                                            int &FrameIndex) const {
+  if (MI->getOpcode() == Cpu0::LD && isFrameAccess(MI, FrameIndex))
+    return MI->getOperand(0).getReg();
+  return 0;
+}
+
+unsigned Cpu0InstrInfo::isLoadFromStackSlotPostFE(const MachineInstr *MI,
+                                                  int &FrameIndex) const {
+  const MachineMemOperand *Dummy;
+  if (MI->getOpcode() == Cpu0::LD &&
+      hasLoadFromStackSlot(MI, Dummy, FrameIndex))
+    return MI->getOperand(0).getReg();
+  return 0;
+}
+
+unsigned Cpu0InstrInfo::isStoreToStackSlot(const MachineInstr *MI,
+                                           int &FrameIndex) const {
+  if (MI->getOpcode() == Cpu0::ST && isFrameAccess(MI, FrameIndex))
+    return MI->getOperand(0).getReg();
+  return 0;
+}
+
+unsigned Cpu0InstrInfo::isStoreToStackSlotPostFE(const MachineInstr *MI,
+                                                 int &FrameIndex) const {
+  const MachineMemOperand *Dummy;
+  if (MI->getOpcode() == Cpu0::ST &&
+      hasStoreToStackSlot(MI, Dummy, FrameIndex))
+    return MI->getOperand(0).getReg();
+  return 0;
+}
+
+// andi $ra, $rb, 0xff   with $rb spilled  =>  lbu $ra, FI+off
+// andi $ra, $rb, 0xffff with $rb spilled  =>  lhu $ra, FI+off
+// Off picks the low order byte or halfword of the word in the slot.
+unsigned Cpu0InstrInfo::GetFoldedLoadOpc(const MachineInstr *MI,
+                                         int64_t &Offset) const {
+  if (MI->getOpcode() != Cpu0::ANDi || !MI->getOperand(2).isImm())
+    return 0;
+
+  bool IsLittle = TM.getSubtarget<Cpu0Subtarget>().isLittle();
+  switch (MI->getOperand(2).getImm()) {
+  default:
+    return 0;
+  case 0xff:
+    Offset = IsLittle ? 0 : 3;
+    return Cpu0::LBu;
+  case 0xffff:
+    Offset = IsLittle ? 0 : 2;
+    return Cpu0::LHu;
+  }
+}
+
+bool Cpu0InstrInfo::
+canFoldMemoryOperand(const MachineInstr *MI,
+                     const SmallVectorImpl<unsigned> &Ops) const {
+  int64_t Offset;
+  if (Ops.size() == 1 && Ops[0] == 1 && GetFoldedLoadOpc(MI, Offset))
+    return true;
+  return TargetInstrInfo::canFoldMemoryOperand(MI, Ops);
+}
+
+/// foldMemoryOperandImpl - Cpu0 has no register-memory arithmetic, so the
+/// only folds beyond the copies TargetInstrInfo handles are the zero
+/// extensions, which load just the bytes they keep.
+MachineInstr* Cpu0InstrInfo::
+foldMemoryOperandImpl(MachineFunction &MF, MachineInstr *MI,
+                      const SmallVectorImpl<unsigned> &Ops,
+                      int FrameIndex) const {
+  if (Ops.size() != 1 || Ops[0] != 1)
+    return 0;
+
+  int64_t Offset;
+  unsigned Opc = GetFoldedLoadOpc(MI, Offset);
+  if (!Opc)
+    return 0;
+
+  const MachineOperand &Dst = MI->getOperand(0);
+  return BuildMI(MF, MI->getDebugLoc(), get(Opc))
+    .addReg(Dst.getReg(), RegState::Define | getDeadRegState(Dst.isDead()),
+            Dst.getSubReg())
+    .addFrameIndex(FrameIndex).addImm(Offset);
+}
+
 MachineInstr*
 Cpu0InstrInfo::emitFrameIndexDebugValue(MachineFunction &MF, int FrameIx,
                                         uint64_t Offset, const MDNode *MDPtr,
@@ -131,6 +680,33 @@ bool Cpu0InstrInfo::expandPostRAPseudo(MachineBasicBlock::iterator MI) const {
   case Cpu0::RetLR:
     ExpandRetLR(MBB, MI, Cpu0::RET);
     break;
+  case Cpu0::LoadAddr:
+    ExpandLoadAddr(MBB, MI);
+    break;
+  case Cpu0::LoadGOT:
+    ExpandLoadGOT(MBB, MI, false);
+    break;
+  case Cpu0::LoadGOTAddr:
+    ExpandLoadGOT(MBB, MI, true);
+    break;
+  }
+
+  MBB.erase(MI);
+  return true;
+}
+
+bool Cpu0InstrInfo::expandGOTLoad(MachineBasicBlock::iterator MI) const {
+  MachineBasicBlock &MBB = *MI->getParent();
+
+  switch (MI->getOpcode()) {
+  default:
+    return false;
+  case Cpu0::LoadGOT:
+    ExpandLoadGOT(MBB, MI, false);
+    break;
+  case Cpu0::LoadGOTAddr:
+    ExpandLoadGOT(MBB, MI, true);
+    break;
   }
 
   MBB.erase(MI);
@@ -143,11 +719,79 @@ void Cpu0InstrInfo::ExpandRetLR(MachineBasicBlock &MBB,
   BuildMI(MBB, I, I->getDebugLoc(), get(Opc)).addReg(Cpu0::LR);
 }
 
+/// withTargetFlags - Return a copy of the symbol operand MO with the
+/// relocation TF.
+static MachineOperand withTargetFlags(const MachineOperand &MO, unsigned TF) {
+  MachineOperand NewMO(MO);
+  NewMO.setTargetFlags(TF);
+  return NewMO;
+}
+
+// lui   $ra, %hi(sym)
+// addiu $ra, $ra, %lo(sym)
+void Cpu0InstrInfo::ExpandLoadAddr(MachineBasicBlock &MBB,
+                                   MachineBasicBlock::iterator I) const {
+  DebugLoc DL = I->getDebugLoc();
+  unsigned Dst = I->getOperand(0).getReg();
+  const MachineOperand &Sym = I->getOperand(1);
+
+  BuildMI(MBB, I, DL, get(Cpu0::LUi), Dst)
+    .addOperand(withTargetFlags(Sym, Cpu0II::MO_ABS_HI));
+  BuildMI(MBB, I, DL, get(Cpu0::ADDiu), Dst).addReg(Dst)
+    .addOperand(withTargetFlags(Sym, Cpu0II::MO_ABS_LO));
+}
+
+// ld    $ra, sym($gp)
+// addiu $ra, $ra, %lo(sym)    if AddLo, with the load from %got(sym)
+// Before register allocation (expandGOTLoad) the loaded value of LoadGOTAddr
+// gets a virtual register of its own, to keep the code in SSA form.
+void Cpu0InstrInfo::ExpandLoadGOT(MachineBasicBlock &MBB,
+                                  MachineBasicBlock::iterator I,
+                                  bool AddLo) const {
+  DebugLoc DL = I->getDebugLoc();
+  unsigned Dst = I->getOperand(0).getReg();
+  const MachineOperand &Sym = I->getOperand(2);
+
+  unsigned Tmp = Dst;
+  if (AddLo && TargetRegisterInfo::isVirtualRegister(Dst)) {
+    MachineRegisterInfo &MRI = MBB.getParent()->getRegInfo();
+    Tmp = MRI.createVirtualRegister(MRI.getRegClass(Dst));
+  }
+
+  BuildMI(MBB, I, DL, get(Cpu0::LD), Tmp)
+    .addOperand(I->getOperand(1))
+    .addOperand(AddLo ? withTargetFlags(Sym, Cpu0II::MO_GOT) : Sym)
+    .setMemRefs(I->memoperands_begin(), I->memoperands_end());
+
+  if (AddLo)
+    BuildMI(MBB, I, DL, get(Cpu0::ADDiu), Dst).addReg(Tmp)
+      .addOperand(withTargetFlags(Sym, Cpu0II::MO_ABS_LO));
+}
+
+/// isReallyTriviallyReMaterializable - LoadAddr can always be recomputed,
+/// and so can the GOT loads from the fixed $gp. In a function whose calls
+/// clobber $gp, EmitGPRestore expands the GOT loads before register
+/// allocation, since $gp is then only valid where it was read before.
+bool Cpu0InstrInfo::isReallyTriviallyReMaterializable(const MachineInstr *MI,
+                                                      AliasAnalysis *AA) const {
+  switch (MI->getOpcode()) {
+  default:
+    return false;
+  case Cpu0::LoadAddr:
+    return true;
+  case Cpu0::LoadGOT:
+  case Cpu0::LoadGOTAddr:
+    return MI->getOperand(1).getReg() == Cpu0::GP;
+  }
+}
+
 /// Return the number of bytes of code the specified instruction may be.
 unsigned Cpu0InstrInfo::GetInstSizeInBytes(const MachineInstr *MI) const {
   switch (MI->getOpcode()) {
   default:
     return MI->getDesc().getSize();
+  case Cpu0::CPRESTORE:                  // lui/add/st for a large offset.
+    return isInt<16>(MI->getOperand(0).getImm()) ? 4 : 12;
   case  TargetOpcode::INLINEASM: {       // Inline Asm: Variable size.
     const MachineFunction *MF = MI->getParent()->getParent();
     const char *AsmStr = MI->getOperand(0).getSymbolName();
@@ -36,6 +36,61 @@ public:
   ///
   virtual const Cpu0RegisterInfo &getRegisterInfo() const;
 
+  /// Branch Analysis
+  virtual bool AnalyzeBranch(MachineBasicBlock &MBB, MachineBasicBlock *&TBB,
+                             MachineBasicBlock *&FBB,
+                             SmallVectorImpl<MachineOperand> &Cond,
+                             bool AllowModify) const;
+
+  virtual unsigned RemoveBranch(MachineBasicBlock &MBB) const;
+
+  virtual unsigned InsertBranch(MachineBasicBlock &MBB, MachineBasicBlock *TBB,
+                                MachineBasicBlock *FBB,
+                                const SmallVectorImpl<MachineOperand> &Cond,
+                                DebugLoc DL) const;
+
+  virtual
+  bool ReverseBranchCondition(SmallVectorImpl<MachineOperand> &Cond) const;
+
+  /// GetOppositeBranchOpc - Return the inverse of the specified
+  /// conditional branch opcode.
+  unsigned GetOppositeBranchOpc(unsigned Opc) const;
+
+  /// getOpcodeLatency - Return the cycles from the issue of Opc until its
+  /// result can be read, from the itineraries: the def operand cycle if the
+  /// itinerary lists one, else the stage latency. Return 1 if the
+  /// itineraries are not available. The cost models of the backend and of
+  /// Cpu0TargetTransformInfo all go through this.
+  unsigned getOpcodeLatency(unsigned Opc) const;
+
+  /// If-conversion with movz/movn
+  virtual bool canInsertSelect(const MachineBasicBlock &MBB,
+                               const SmallVectorImpl<MachineOperand> &Cond,
+                               unsigned TrueReg, unsigned FalseReg,
+                               int &CondCycles, int &TrueCycles,
+                               int &FalseCycles) const;
+
+  virtual void insertSelect(MachineBasicBlock &MBB,
+                            MachineBasicBlock::iterator I, DebugLoc DL,
+                            unsigned DstReg,
+                            const SmallVectorImpl<MachineOperand> &Cond,
+                            unsigned TrueReg, unsigned FalseReg) const;
+
+  /// GetSwappedBranchOpc - Return the branch testing the same condition on
+  /// the flags of a cmp with its operands swapped, or 0 if Opc is not a
+  /// branch on the flags.
+  unsigned GetSwappedBranchOpc(unsigned Opc) const;
+
+  /// Compare optimization
+  virtual bool analyzeCompare(const MachineInstr *MI, unsigned &SrcReg,
+                              unsigned &SrcReg2, int &CmpMask,
+                              int &CmpValue) const;
+
+  virtual bool optimizeCompareInstr(MachineInstr *CmpInstr, unsigned SrcReg,
+                                    unsigned SrcReg2, int CmpMask,
+                                    int CmpValue,
+                                    const MachineRegisterInfo *MRI) const;
+
   virtual void copyPhysReg(MachineBasicBlock &MBB,
                            MachineBasicBlock::iterator MI, DebugLoc DL,
                            unsigned DestReg, unsigned SrcReg,
@@ -56,6 +111,35 @@ public:
                                     const TargetRegisterClass *RC,
                                     const TargetRegisterInfo *TRI) const;
 
+  /// isLoadFromStackSlot - If MI is a full word load from a stack slot,
+  /// return the destination register and set FrameIndex.
+  virtual unsigned isLoadFromStackSlot(const MachineInstr *MI,
+                                       int &FrameIndex) const;
+  virtual unsigned isLoadFromStackSlotPostFE(const MachineInstr *MI,
+                                             int &FrameIndex) const;
+
+  /// isStoreToStackSlot - If MI is a full word store to a stack slot,
+  /// return the stored register and set FrameIndex.
+  virtual unsigned isStoreToStackSlot(const MachineInstr *MI,
+                                      int &FrameIndex) const;
+  virtual unsigned isStoreToStackSlotPostFE(const MachineInstr *MI,
+                                            int &FrameIndex) const;
+
+  virtual bool canFoldMemoryOperand(const MachineInstr *MI,
+                                    const SmallVectorImpl<unsigned> &Ops) const;
+
+  virtual MachineInstr* foldMemoryOperandImpl(MachineFunction &MF,
+                                              MachineInstr *MI,
+                                        const SmallVectorImpl<unsigned> &Ops,
+                                              int FrameIndex) const;
+
+  virtual MachineInstr* foldMemoryOperandImpl(MachineFunction &MF,
+                                              MachineInstr *MI,
+                                        const SmallVectorImpl<unsigned> &Ops,
+                                              MachineInstr *LoadMI) const {
+    return 0;
+  }
+
   virtual MachineInstr* emitFrameIndexDebugValue(MachineFunction &MF,
                                                  int FrameIx, uint64_t Offset,
                                                  const MDNode *MDPtr,
@@ -65,9 +149,37 @@ public:
   /// Expand Pseudo instructions into real backend instructions
   virtual bool expandPostRAPseudo(MachineBasicBlock::iterator MI) const;
 
+  /// expandGOTLoad - Expand a LoadGOT or LoadGOTAddr before register
+  /// allocation, for EmitGPRestore. Return false for any other instruction.
+  bool expandGOTLoad(MachineBasicBlock::iterator MI) const;
+
+  /// The address pseudos have no register input but the reserved $gp.
+  virtual bool isReallyTriviallyReMaterializable(const MachineInstr *MI,
+                                                 AliasAnalysis *AA) const;
+
 private:
+  unsigned GetAnalyzableBrOpc(unsigned Opc) const;
+
+  /// GetFoldedLoadOpc - Return the narrow load that replaces MI when its
+  /// source operand is spilled, or 0. Offset is set to the position of the
+  /// bytes in the slot.
+  unsigned GetFoldedLoadOpc(const MachineInstr *MI, int64_t &Offset) const;
+
+  void AnalyzeCondBr(const MachineInstr *Inst, unsigned Opc,
+                     MachineBasicBlock *&BB,
+                     SmallVectorImpl<MachineOperand> &Cond) const;
+
+  void BuildCondBr(MachineBasicBlock &MBB, MachineBasicBlock *TBB, DebugLoc DL,
+                   const SmallVectorImpl<MachineOperand> &Cond) const;
+
   void ExpandRetLR(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
                    unsigned Opc) const;
+
+  void ExpandLoadAddr(MachineBasicBlock &MBB,
+                      MachineBasicBlock::iterator I) const;
+
+  void ExpandLoadGOT(MachineBasicBlock &MBB, MachineBasicBlock::iterator I,
+                     bool AddLo) const;
 };
 }
 
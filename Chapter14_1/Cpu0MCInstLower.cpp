@@ -35,7 +35,7 @@ void Cpu0MCInstLower::Initialize(MCContext* C) {
 
 MCOperand Cpu0MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
                                               MachineOperandType MOTy,
-                                              unsigned Offset) const {
+                                              int64_t Offset) const {
   MCSymbolRefExpr::VariantKind Kind;
   const MCSymbol *Symbol;
 
@@ -68,6 +68,7 @@ MCOperand Cpu0MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
   switch (MOTy) {
   case MachineOperand::MO_GlobalAddress:
     Symbol = AsmPrinter.getSymbol(MO.getGlobal());
+    Offset += MO.getOffset();
     break;
 
   case MachineOperand::MO_MachineBasicBlock:
@@ -88,6 +89,11 @@ MCOperand Cpu0MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
     Symbol = AsmPrinter.GetJTISymbol(MO.getIndex());
     break;
 
+  case MachineOperand::MO_ConstantPoolIndex:
+    Symbol = AsmPrinter.GetCPISymbol(MO.getIndex());
+    Offset += MO.getOffset();
+    break;
+
   default:
     llvm_unreachable("<unknown operand type>");
   }
@@ -97,9 +103,8 @@ MCOperand Cpu0MCInstLower::LowerSymbolOperand(const MachineOperand &MO,
   if (!Offset)
     return MCOperand::CreateExpr(MCSym);
 
-  // Assume offset is never negative.
-  assert(Offset > 0);
-
+  // A folded offset may be negative, e.g. &a[-1]; sym+(-4) prints and
+  // relocates as sym-4.
   const MCConstantExpr *OffsetExpr =  MCConstantExpr::Create(Offset, *Ctx);
   const MCBinaryExpr *AddExpr = MCBinaryExpr::CreateAdd(MCSym, OffsetExpr, *Ctx);
   return MCOperand::CreateExpr(AddExpr);
@@ -166,6 +171,26 @@ void Cpu0MCInstLower::LowerCPRESTORE(int64_t Offset,
   MCInsts.push_back(St);
 } // lbd document - mark - LowerCPRESTORE
 
+// Lower "LoadJTEntry $ra, $table, $index" to
+//  "shl   $ra, $index, log2(EntrySize)"
+//  "addu  $ra, $table, $ra"
+//  "lh    $ra, 0($ra)"  (or "ld" for 4-byte entries)
+void Cpu0MCInstLower::LowerLoadJTEntry(const MachineInstr *MI,
+                                       unsigned EntrySize,
+                                       SmallVector<MCInst, 4>& MCInsts) {
+  assert((EntrySize == 2 || EntrySize == 4) && "Unexpected entry size");
+  MCOperand DstReg = MCOperand::CreateReg(MI->getOperand(0).getReg());
+  MCOperand TableReg = MCOperand::CreateReg(MI->getOperand(1).getReg());
+  MCOperand IndexReg = MCOperand::CreateReg(MI->getOperand(2).getReg());
+
+  MCInsts.resize(3);
+  CreateMCInst(MCInsts[0], Cpu0::SHL, DstReg, IndexReg,
+               MCOperand::CreateImm(Log2_32(EntrySize)));
+  CreateMCInst(MCInsts[1], Cpu0::ADDu, DstReg, TableReg, DstReg);
+  CreateMCInst(MCInsts[2], EntrySize == 2 ? Cpu0::LH : Cpu0::LD, DstReg,
+               DstReg, MCOperand::CreateImm(0));
+}
+
 MCOperand Cpu0MCInstLower::LowerOperand(const MachineOperand& MO,
                                         unsigned offset) const {
   MachineOperandType MOTy = MO.getType();
@@ -182,6 +207,7 @@ MCOperand Cpu0MCInstLower::LowerOperand(const MachineOperand& MO,
   case MachineOperand::MO_GlobalAddress:
   case MachineOperand::MO_ExternalSymbol:
   case MachineOperand::MO_JumpTableIndex:
+  case MachineOperand::MO_ConstantPoolIndex:
   case MachineOperand::MO_BlockAddress:
     return LowerSymbolOperand(MO, MOTy, offset);
   case MachineOperand::MO_RegisterMask:
@@ -192,7 +218,18 @@ MCOperand Cpu0MCInstLower::LowerOperand(const MachineOperand& MO,
 }
 
 void Cpu0MCInstLower::Lower(const MachineInstr *MI, MCInst &OutMI) const {
-  OutMI.setOpcode(MI->getOpcode());
+  // Tail calls are plain jumps once the epilogue has run.
+  switch (MI->getOpcode()) {
+  default:
+    OutMI.setOpcode(MI->getOpcode());
+    break;
+  case Cpu0::TAILCALL:
+    OutMI.setOpcode(Cpu0::JMP);
+    break;
+  case Cpu0::TAILCALL_R:
+    OutMI.setOpcode(Cpu0::JR);
+    break;
+  }
 
   for (unsigned i = 0, e = MI->getNumOperands(); i != e; ++i) {
     const MachineOperand &MO = MI->getOperand(i);
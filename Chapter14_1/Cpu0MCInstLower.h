@@ -33,9 +33,11 @@ public:
   void Lower(const MachineInstr *MI, MCInst &OutMI) const;
   void LowerCPLOAD(SmallVector<MCInst, 4>& MCInsts);
   void LowerCPRESTORE(int64_t Offset, SmallVector<MCInst, 4>& MCInsts);
+  void LowerLoadJTEntry(const MachineInstr *MI, unsigned EntrySize,
+                        SmallVector<MCInst, 4>& MCInsts);
 private:
   MCOperand LowerSymbolOperand(const MachineOperand &MO,
-                               MachineOperandType MOTy, unsigned Offset) const;
+                               MachineOperandType MOTy, int64_t Offset) const;
   MCOperand LowerOperand(const MachineOperand& MO, unsigned offset = 0) const;
 };
 }
@@ -18,11 +18,16 @@
 using namespace llvm;
 
 bool FixGlobalBaseReg = true;
+extern bool Cpu0ReserveGP;
 
 bool Cpu0FunctionInfo::globalBaseRegFixed() const {
   return FixGlobalBaseReg;
 }
 
+bool Cpu0FunctionInfo::globalBaseRegReserved() const {
+  return FixGlobalBaseReg && (GlobalBaseReg || Cpu0ReserveGP);
+}
+
 bool Cpu0FunctionInfo::globalBaseRegSet() const {
   return GlobalBaseReg;
 }
@@ -36,6 +36,11 @@ class Cpu0FunctionInfo : public MachineFunctionInfo {
   /// relocation models.
   unsigned GlobalBaseReg;
 
+  /// UsesGP - Whether the selected instructions read $gp. Lowering asks for
+  /// the global base register before the DAG is optimized, so this is
+  /// decided again once instruction selection is done.
+  bool UsesGP;
+
     /// VarArgsFrameIndex - FrameIndex for start of varargs area.
   int VarArgsFrameIndex;
 
@@ -51,15 +56,32 @@ class Cpu0FunctionInfo : public MachineFunctionInfo {
   unsigned MaxCallFrameSize;
   bool EmitNOAT;
 
+  /// IncomingArgSize - Size of the incoming argument area on the stack. A
+  /// tail call may only store its stack arguments inside this area.
+  unsigned IncomingArgSize;
+
+  /// JumpTableEntrySize - Size in bytes of the jump table entries, or 0 if
+  /// not decided yet.
+  unsigned JumpTableEntrySize;
+
+  /// SaveBlock - Block the prologue and the callee-saved spills are placed
+  /// in, or null for the entry block.
+  MachineBasicBlock *SaveBlock;
+
+  /// EarlyExitBlock - Return block reached straight from the entry block,
+  /// before SaveBlock, that runs without a frame. Null if there is none.
+  MachineBasicBlock *EarlyExitBlock;
+
 public:
   Cpu0FunctionInfo(MachineFunction& MF)
   : MF(MF), 
     SRetReturnReg(0),
-    GlobalBaseReg(0),
+    GlobalBaseReg(0), UsesGP(true),
     VarArgsFrameIndex(0), InArgFIRange(std::make_pair(-1, 0)),
     OutArgFIRange(std::make_pair(-1, 0)), GPFI(0), DynAllocFI(0),
     EmitNOAT(false), 
-    MaxCallFrameSize(0)
+    MaxCallFrameSize(0), IncomingArgSize(0), JumpTableEntrySize(0),
+    SaveBlock(nullptr), EarlyExitBlock(nullptr)
     {}
 
   bool isInArgFI(int FI) const {
@@ -97,14 +119,39 @@ public:
   void setSRetReturnReg(unsigned Reg) { SRetReturnReg = Reg; }
 
   bool globalBaseRegFixed() const;
+
+  /// globalBaseRegReserved - With a fixed global base register, $gp is only
+  /// kept out of register allocation in the functions that address
+  /// something through it. The others may allocate it as a callee-saved
+  /// register.
+  bool globalBaseRegReserved() const;
   bool globalBaseRegSet() const;
   unsigned getGlobalBaseReg();
 
+  bool usesGP() const { return UsesGP; }
+  void setUsesGP(bool V) { UsesGP = V; }
+
   int getVarArgsFrameIndex() const { return VarArgsFrameIndex; }
   void setVarArgsFrameIndex(int Index) { VarArgsFrameIndex = Index; }
 
   unsigned getMaxCallFrameSize() const { return MaxCallFrameSize; }
   void setMaxCallFrameSize(unsigned S) { MaxCallFrameSize = S; }
+  unsigned getIncomingArgSize() const { return IncomingArgSize; }
+  void setIncomingArgSize(unsigned S) { IncomingArgSize = S; }
+
+  /// Jump table entries are the distance of the case block from the table
+  /// at the end of the function. Cpu0AsmPrinter sets their size once the
+  /// code is final: 2 bytes unless the function is too large for that.
+  unsigned getJumpTableEntrySize() const { return JumpTableEntrySize; }
+  void setJumpTableEntrySize(unsigned S) { JumpTableEntrySize = S; }
+
+  MachineBasicBlock *getSaveBlock() const { return SaveBlock; }
+  MachineBasicBlock *getEarlyExitBlock() const { return EarlyExitBlock; }
+  void setShrinkWrapBlocks(MachineBasicBlock *Save, MachineBasicBlock *Exit) {
+    SaveBlock = Save;
+    EarlyExitBlock = Exit;
+  }
+
   bool getEmitNOAT() const { return EmitNOAT; }
   void setEmitNOAT() { EmitNOAT = true; }
 };
@@ -0,0 +1,147 @@
+//===-- Cpu0OptimizeCmp.cpp - Cpu0 compare optimization -------------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// On cpu032I every conditional branch and setcc reads the flags a cmp left
+// in $sw. $sw is the only register of its class, so two flag values that
+// are live at the same time make the allocator spill $sw. This pass runs
+// on SSA form before register allocation and, block by block:
+//
+//  - sinks each cmp down to its first reader, so the flags are live for as
+//    short a stretch as possible and do not overlap the flags of another
+//    cmp;
+//  - then removes a cmp whose flags are still in $sw from an earlier cmp of
+//    the same (or swapped) registers, through
+//    Cpu0InstrInfo::optimizeCompareInstr. A jlt followed by a jeq on the
+//    same pair then share a single cmp.
+//
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cpu0-optimize-cmp"
+
+#include "Cpu0.h"
+#include "Cpu0TargetMachine.h"
+#include "llvm/CodeGen/MachineFunctionPass.h"
+#include "llvm/CodeGen/MachineRegisterInfo.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Target/TargetInstrInfo.h"
+#include "llvm/ADT/Statistic.h"
+
+using namespace llvm;
+
+STATISTIC(NumSunk,   "Number of cmp sunk to their first use");
+STATISTIC(NumErased, "Number of redundant cmp removed");
+
+static cl::opt<bool> DisableCmpOpt(
+  "disable-cpu0-cmp-opt",
+  cl::init(false),
+  cl::desc("Do not sink or remove redundant cmp instructions."),
+  cl::Hidden);
+
+namespace {
+  struct OptimizeCmp : public MachineFunctionPass {
+
+    TargetMachine &TM;
+    const TargetInstrInfo *TII;
+
+    static char ID;
+    OptimizeCmp(TargetMachine &tm)
+      : MachineFunctionPass(ID), TM(tm), TII(tm.getInstrInfo()) { }
+
+    virtual const char *getPassName() const {
+      return "Cpu0 Optimize Cmp";
+    }
+
+    bool runOnMachineFunction(MachineFunction &F);
+    bool sinkCompare(MachineInstr *Cmp);
+  };
+  char OptimizeCmp::ID = 0;
+} // end of anonymous namespace
+
+/// sinkCompare - Move Cmp down to just before the first instruction of its
+/// block that reads its flags, or before the terminators if the flags are
+/// only used by the successors. Return true if Cmp was moved.
+bool OptimizeCmp::sinkCompare(MachineInstr *Cmp) {
+  MachineBasicBlock *MBB = Cmp->getParent();
+  unsigned FlagReg = Cmp->getOperand(0).getReg();
+  MachineBasicBlock::iterator Next = Cmp;
+  ++Next;
+
+  MachineBasicBlock::iterator I = Next;
+  for (MachineBasicBlock::iterator E = MBB->end(); I != E; ++I) {
+    if (I->isTerminator() || I->readsRegister(FlagReg))
+      break;
+
+    // Virtual registers cannot change in SSA form; a physical register
+    // other than $zero can.
+    bool Clobbered = false;
+    for (unsigned i = 1; i != 3; ++i) {
+      unsigned Reg = Cmp->getOperand(i).getReg();
+      if (TargetRegisterInfo::isPhysicalRegister(Reg) && Reg != Cpu0::ZERO &&
+          I->modifiesRegister(Reg, TM.getRegisterInfo()))
+        Clobbered = true;
+    }
+    if (Clobbered)
+      break;
+  }
+
+  if (I == Next)
+    return false;
+
+  MBB->splice(I, MBB, Cmp);
+  return true;
+}
+
+bool OptimizeCmp::runOnMachineFunction(MachineFunction &F) {
+  if (DisableCmpOpt || !TM.getSubtarget<Cpu0Subtarget>().hasCmp())
+    return false;
+
+  MachineRegisterInfo &MRI = F.getRegInfo();
+  if (!MRI.isSSA())
+    return false;
+
+  bool Changed = false;
+
+  for (MachineFunction::iterator MFI = F.begin(), MFE = F.end();
+       MFI != MFE; ++MFI) {
+    SmallVector<MachineInstr*, 8> Cmps;
+    for (MachineBasicBlock::iterator I = MFI->begin(), E = MFI->end();
+         I != E; ++I)
+      if (I->getOpcode() == Cpu0::CMP &&
+          TargetRegisterInfo::isVirtualRegister(I->getOperand(0).getReg()))
+        Cmps.push_back(I);
+
+    // Sink from the bottom up, so a cmp never has to pass one that is
+    // about to move.
+    for (unsigned i = Cmps.size(); i != 0; --i)
+      if (sinkCompare(Cmps[i-1])) {
+        ++NumSunk;
+        Changed = true;
+      }
+
+    // Now in block order, so the earlier cmp of a pair is the one kept.
+    for (unsigned i = 0, e = Cmps.size(); i != e; ++i) {
+      unsigned SrcReg, SrcReg2;
+      int CmpMask, CmpValue;
+      if (TII->analyzeCompare(Cmps[i], SrcReg, SrcReg2, CmpMask, CmpValue) &&
+          TII->optimizeCompareInstr(Cmps[i], SrcReg, SrcReg2, CmpMask,
+                                    CmpValue, &MRI)) {
+        ++NumErased;
+        Changed = true;
+      }
+    }
+  }
+
+  return Changed;
+}
+
+/// createCpu0OptimizeCmpPass - Returns a pass that sinks cmp instructions
+/// and removes redundant ones.
+FunctionPass *llvm::createCpu0OptimizeCmpPass(Cpu0TargetMachine &tm) {
+  return new OptimizeCmp(tm);
+}
@@ -41,6 +41,8 @@
 
 using namespace llvm;
 
+extern bool FixGlobalBaseReg;
+
 Cpu0RegisterInfo::Cpu0RegisterInfo(const Cpu0Subtarget &ST,
                                    const TargetInstrInfo &tii)
   : Cpu0GenRegisterInfo(Cpu0::LR), Subtarget(ST), TII(tii) {}
@@ -56,12 +58,24 @@ Cpu0RegisterInfo::Cpu0RegisterInfo(const Cpu0Subtarget &ST,
 const uint16_t* Cpu0RegisterInfo::
 getCalleeSavedRegs(const MachineFunction *MF) const
 {
+  if (MF) {
+    const Cpu0FunctionInfo *Cpu0FI = MF->getInfo<Cpu0FunctionInfo>();
+    if (Cpu0FI->globalBaseRegFixed() && !Cpu0FI->globalBaseRegReserved())
+      return CSR_O32_GP_SaveList;
+  }
   return CSR_O32_SaveList;
 }
 
+// A callee either saves $gp (CSR_O32_GP) or uses it as the global base.
+// Outside PIC the global base is set once and never changes, so a call
+// preserves $gp whenever it is fixed. In PIC code the callee's .cpload may
+// load the $gp of another module, and only the caller's .cprestore slot
+// brings its own back.
 const uint32_t*
 Cpu0RegisterInfo::getCallPreservedMask(CallingConv::ID) const
 {
+  if (FixGlobalBaseReg && Subtarget.getRelocationModel() != Reloc::PIC_)
+    return CSR_O32_GP_RegMask;
   return CSR_O32_RegMask; 
 }
 
@@ -83,8 +97,8 @@ getReservedRegs(const MachineFunction &MF) const {
   }
 
   const Cpu0FunctionInfo *Cpu0FI = MF.getInfo<Cpu0FunctionInfo>();
-  // Reserve GP if globalBaseRegFixed()
-  if (Cpu0FI->globalBaseRegFixed())
+  // Reserve GP if this function uses it as the global base register.
+  if (Cpu0FI->globalBaseRegReserved())
     Reserved.set(Cpu0::GP);
 
   return Reserved;
@@ -12,13 +12,198 @@
 //===----------------------------------------------------------------------===//
 
 #include "Cpu0TargetMachine.h"
+#include "llvm/CodeGen/SelectionDAG.h"
+#include "llvm/Support/CommandLine.h"
 
 using namespace llvm;
 
 #define DEBUG_TYPE "cpu0-selectiondag-info"
 
+static cl::opt<unsigned> MemOpInlineLimit(
+  "cpu0-memop-inline-limit",
+  cl::init(64),
+  cl::desc("Largest constant size in bytes of a word aligned memcpy or "
+           "memset expanded inline instead of calling the library."),
+  cl::Hidden);
+
+// Every value loaded by an inline memmove is live until all the loads are
+// done, so keep the copy within the registers the allocator can hand out.
+static const unsigned MaxMemmoveOps = 8;
+
 Cpu0SelectionDAGInfo::Cpu0SelectionDAGInfo(const DataLayout &DL)
     : TargetSelectionDAGInfo(&DL) {}
 
 Cpu0SelectionDAGInfo::~Cpu0SelectionDAGInfo() {
 }
+
+/// getLoadGroupSize - Return how many loads to issue ahead of their stores.
+/// The load to use latency of ld is taken from the itineraries, so that the
+/// first store of a group does not stall waiting for its value.
+static unsigned getLoadGroupSize(SelectionDAG &DAG) {
+  const Cpu0InstrInfo *TII =
+    static_cast<const Cpu0InstrInfo*>(DAG.getTarget().getInstrInfo());
+  return TII->getOpcodeLatency(Cpu0::LD);
+}
+
+/// getMemOps - Split a copy of Size bytes into word accesses followed by a
+/// byte tail. Each entry is the memory type and the offset of the access.
+static void getMemOps(uint64_t Size,
+                      SmallVectorImpl<std::pair<MVT, uint64_t> > &Ops) {
+  uint64_t Offset = 0;
+  for (; Offset + 4 <= Size; Offset += 4)
+    Ops.push_back(std::make_pair(MVT::i32, Offset));
+  for (; Offset < Size; ++Offset)
+    Ops.push_back(std::make_pair(MVT::i8, Offset));
+}
+
+/// emitCopy - Copy Size bytes from Src to Dst with ld/st for the words and
+/// lb/sb for the tail. The accesses are emitted in groups of GroupSize
+/// loads followed by their stores; the chain ties each group to the
+/// previous one so the loads of a group never pass the earlier stores.
+static SDValue emitCopy(SelectionDAG &DAG, SDLoc dl, SDValue Chain,
+                        SDValue Dst, SDValue Src, uint64_t Size,
+                        unsigned GroupSize, bool isVolatile,
+                        MachinePointerInfo DstPtrInfo,
+                        MachinePointerInfo SrcPtrInfo) {
+  SmallVector<std::pair<MVT, uint64_t>, 16> Ops;
+  getMemOps(Size, Ops);
+
+  for (unsigned I = 0, E = Ops.size(); I < E; I += GroupSize) {
+    unsigned N = std::min(GroupSize, E - I);
+    SmallVector<SDValue, 8> Values;
+    SmallVector<SDValue, 8> Chains;
+
+    for (unsigned J = 0; J != N; ++J) {
+      MVT VT = Ops[I + J].first;
+      uint64_t Off = Ops[I + J].second;
+      SDValue Addr = DAG.getNode(ISD::ADD, dl, MVT::i32, Src,
+                                 DAG.getConstant(Off, MVT::i32));
+      SDValue Val;
+      if (VT == MVT::i32)
+        Val = DAG.getLoad(MVT::i32, dl, Chain, Addr,
+                          SrcPtrInfo.getWithOffset(Off), isVolatile,
+                          false, false, 4);
+      else
+        Val = DAG.getExtLoad(ISD::EXTLOAD, dl, MVT::i32, Chain, Addr,
+                             SrcPtrInfo.getWithOffset(Off), MVT::i8,
+                             isVolatile, false, 1);
+      Values.push_back(Val);
+      Chains.push_back(Val.getValue(1));
+    }
+    Chain = DAG.getNode(ISD::TokenFactor, dl, MVT::Other, Chains);
+
+    Chains.clear();
+    for (unsigned J = 0; J != N; ++J) {
+      MVT VT = Ops[I + J].first;
+      uint64_t Off = Ops[I + J].second;
+      SDValue Addr = DAG.getNode(ISD::ADD, dl, MVT::i32, Dst,
+                                 DAG.getConstant(Off, MVT::i32));
+      if (VT == MVT::i32)
+        Chains.push_back(DAG.getStore(Chain, dl, Values[J], Addr,
+                                      DstPtrInfo.getWithOffset(Off),
+                                      isVolatile, false, 4));
+      else
+        Chains.push_back(DAG.getTruncStore(Chain, dl, Values[J], Addr,
+                                           DstPtrInfo.getWithOffset(Off),
+                                           MVT::i8, false, isVolatile, 1));
+    }
+    Chain = DAG.getNode(ISD::TokenFactor, dl, MVT::Other, Chains);
+  }
+
+  return Chain;
+}
+
+SDValue Cpu0SelectionDAGInfo::
+EmitTargetCodeForMemcpy(SelectionDAG &DAG, SDLoc dl, SDValue Chain,
+                        SDValue Dst, SDValue Src, SDValue Size,
+                        unsigned Align, bool isVolatile, bool AlwaysInline,
+                        MachinePointerInfo DstPtrInfo,
+                        MachinePointerInfo SrcPtrInfo) const {
+  // Variable sizes and copies that are not word aligned go to the library,
+  // unless the generic expansion has to inline them.
+  ConstantSDNode *ConstantSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstantSize || (Align & 3) != 0)
+    return SDValue();
+
+  uint64_t SizeVal = ConstantSize->getZExtValue();
+  if (!AlwaysInline && SizeVal > MemOpInlineLimit)
+    return SDValue();
+
+  return emitCopy(DAG, dl, Chain, Dst, Src, SizeVal, getLoadGroupSize(DAG),
+                  isVolatile, DstPtrInfo, SrcPtrInfo);
+}
+
+SDValue Cpu0SelectionDAGInfo::
+EmitTargetCodeForMemmove(SelectionDAG &DAG, SDLoc dl, SDValue Chain,
+                         SDValue Dst, SDValue Src, SDValue Size,
+                         unsigned Align, bool isVolatile,
+                         MachinePointerInfo DstPtrInfo,
+                         MachinePointerInfo SrcPtrInfo) const {
+  ConstantSDNode *ConstantSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstantSize || (Align & 3) != 0)
+    return SDValue();
+
+  // The regions may overlap, so load everything before the first store.
+  SmallVector<std::pair<MVT, uint64_t>, 16> Ops;
+  uint64_t SizeVal = ConstantSize->getZExtValue();
+  getMemOps(SizeVal, Ops);
+  if (Ops.empty() || Ops.size() > MaxMemmoveOps)
+    return SDValue();
+
+  return emitCopy(DAG, dl, Chain, Dst, Src, SizeVal, Ops.size(),
+                  isVolatile, DstPtrInfo, SrcPtrInfo);
+}
+
+SDValue Cpu0SelectionDAGInfo::
+EmitTargetCodeForMemset(SelectionDAG &DAG, SDLoc dl, SDValue Chain,
+                        SDValue Dst, SDValue Src, SDValue Size,
+                        unsigned Align, bool isVolatile,
+                        MachinePointerInfo DstPtrInfo) const {
+  ConstantSDNode *ConstantSize = dyn_cast<ConstantSDNode>(Size);
+  if (!ConstantSize || (Align & 3) != 0)
+    return SDValue();
+
+  uint64_t SizeVal = ConstantSize->getZExtValue();
+  if (SizeVal > MemOpInlineLimit)
+    return SDValue();
+
+  // Replicate the byte into all four bytes of a word. A constant is folded
+  // here, otherwise it costs two shl/or pairs, done once for the whole set.
+  SDValue Byte, Word;
+  if (ConstantSDNode *V = dyn_cast<ConstantSDNode>(Src)) {
+    uint32_t B = V->getZExtValue() & 0xff;
+    Byte = DAG.getConstant(B, MVT::i32);
+    Word = DAG.getConstant(B * 0x01010101U, MVT::i32);
+  } else {
+    Byte = DAG.getZExtOrTrunc(Src, dl, MVT::i32);
+    Word = DAG.getNode(ISD::OR, dl, MVT::i32, Byte,
+                       DAG.getNode(ISD::SHL, dl, MVT::i32, Byte,
+                                   DAG.getConstant(8, MVT::i32)));
+    Word = DAG.getNode(ISD::OR, dl, MVT::i32, Word,
+                       DAG.getNode(ISD::SHL, dl, MVT::i32, Word,
+                                   DAG.getConstant(16, MVT::i32)));
+  }
+
+  SmallVector<std::pair<MVT, uint64_t>, 16> Ops;
+  getMemOps(SizeVal, Ops);
+
+  // The stores are independent of each other.
+  SmallVector<SDValue, 16> Chains;
+  for (unsigned I = 0, E = Ops.size(); I != E; ++I) {
+    uint64_t Off = Ops[I].second;
+    SDValue Addr = DAG.getNode(ISD::ADD, dl, MVT::i32, Dst,
+                               DAG.getConstant(Off, MVT::i32));
+    if (Ops[I].first == MVT::i32)
+      Chains.push_back(DAG.getStore(Chain, dl, Word, Addr,
+                                    DstPtrInfo.getWithOffset(Off),
+                                    isVolatile, false, 4));
+    else
+      Chains.push_back(DAG.getTruncStore(Chain, dl, Byte, Addr,
+                                         DstPtrInfo.getWithOffset(Off),
+                                         MVT::i8, false, isVolatile, 1));
+  }
+  if (Chains.empty())
+    return Chain;
+
+  return DAG.getNode(ISD::TokenFactor, dl, MVT::Other, Chains);
+}
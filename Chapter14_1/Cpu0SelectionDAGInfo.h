@@ -24,6 +24,29 @@ class Cpu0SelectionDAGInfo : public TargetSelectionDAGInfo {
 public:
   explicit Cpu0SelectionDAGInfo(const DataLayout &DL);
   ~Cpu0SelectionDAGInfo();
+
+  virtual SDValue EmitTargetCodeForMemcpy(SelectionDAG &DAG, SDLoc dl,
+                                          SDValue Chain,
+                                          SDValue Dst, SDValue Src,
+                                          SDValue Size, unsigned Align,
+                                          bool isVolatile, bool AlwaysInline,
+                                          MachinePointerInfo DstPtrInfo,
+                                          MachinePointerInfo SrcPtrInfo) const;
+
+  virtual SDValue EmitTargetCodeForMemmove(SelectionDAG &DAG, SDLoc dl,
+                                           SDValue Chain,
+                                           SDValue Dst, SDValue Src,
+                                           SDValue Size, unsigned Align,
+                                           bool isVolatile,
+                                           MachinePointerInfo DstPtrInfo,
+                                           MachinePointerInfo SrcPtrInfo) const;
+
+  virtual SDValue EmitTargetCodeForMemset(SelectionDAG &DAG, SDLoc dl,
+                                          SDValue Chain,
+                                          SDValue Dst, SDValue Src,
+                                          SDValue Size, unsigned Align,
+                                          bool isVolatile,
+                                          MachinePointerInfo DstPtrInfo) const;
 };
 
 }
@@ -37,6 +37,11 @@ static cl::opt<bool> NoCploadOpt
                 ("cpu0-no-cpload", cl::Hidden, cl::init(false),
                  cl::desc("No issue .cpload"));
 
+static cl::opt<bool> RegArgsOpt
+                ("cpu0-reg-args", cl::Hidden, cl::init(false),
+                 cl::desc("Pass the first integer arguments in $a0, $a1, $t9 "
+                 "and $t0. Variable argument calls still use the stack."));
+
 bool Cpu0ReserveGP;
 bool Cpu0NoCpload;
 
@@ -77,6 +82,7 @@ Cpu0Subtarget::Cpu0Subtarget(const std::string &TT, const std::string &CPU,
 
   // Set UseSmallSection.
   UseSmallSection = UseSmallSectionOpt;
+  UseRegArgs = RegArgsOpt;
   Cpu0ReserveGP = ReserveGPOpt;
   Cpu0NoCpload = NoCploadOpt;
   if (RM == Reloc::Static && !UseSmallSection && !Cpu0ReserveGP)
@@ -85,3 +91,15 @@ Cpu0Subtarget::Cpu0Subtarget(const std::string &TT, const std::string &CPU,
     FixGlobalBaseReg = true;
 }
 
+bool Cpu0Subtarget::enableMachineScheduler() const {
+  return true;
+}
+
+bool Cpu0Subtarget::enablePostRAScheduler(CodeGenOpt::Level OptLevel,
+                                          AntiDepBreakMode &Mode,
+                                          RegClassVector &CriticalPathRCs)
+  const {
+  Mode = TargetSubtargetInfo::ANTIDEP_NONE;
+  CriticalPathRCs.clear();
+  return OptLevel >= CodeGenOpt::Default;
+}
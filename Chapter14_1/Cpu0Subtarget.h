@@ -64,6 +64,9 @@ protected:
   // UseSmallSection - Small section is used.
   bool UseSmallSection;
 
+  // UseRegArgs - Pass the first integer arguments in registers.
+  bool UseRegArgs;
+
 public:
   unsigned getTargetABI() const { return Cpu0ABI; }
 
@@ -87,7 +90,20 @@ public:
   bool hasCmp()   const { return HasCmp; }
   bool hasSlt()   const { return HasSlt; }
 
+  Reloc::Model getRelocationModel() const { return RM; }
   bool useSmallSection() const { return UseSmallSection; }
+  bool useRegArgs() const { return UseRegArgs; }
+
+  /// getInstrItineraryData - Return the instruction itineraries based on
+  /// subtarget selection.
+  const InstrItineraryData &getInstrItineraryData() const { return InstrItins; }
+
+  /// Scheduling: run the MachineScheduler before register allocation and
+  /// the post-RA list scheduler after it.
+  virtual bool enableMachineScheduler() const;
+  virtual bool enablePostRAScheduler(CodeGenOpt::Level OptLevel,
+                                     AntiDepBreakMode& Mode,
+                                     RegClassVector& CriticalPathRCs) const;
 };
 } // End llvm namespace
 
@@ -15,9 +15,16 @@
 #include "Cpu0.h"
 #include "llvm/PassManager.h"
 #include "llvm/CodeGen/Passes.h"
+#include "llvm/Support/CommandLine.h"
 #include "llvm/Support/TargetRegistry.h"
 using namespace llvm;
 
+static cl::opt<bool> Cpu0EarlyIfConv(
+  "cpu0-early-ifcvt",
+  cl::init(true),
+  cl::desc("Enable early if-conversion with movz/movn on cpu032II."),
+  cl::Hidden);
+
 extern "C" void LLVMInitializeCpu0Target() {
   // Register the target.
   //- Big endian Target Machine
@@ -83,6 +90,7 @@ public:
     return *getCpu0TargetMachine().getSubtargetImpl();
   } // lbd document - mark - getCpu0Subtarget()
   virtual bool addInstSelector();
+  virtual bool addILPOpts();
   virtual bool addPreRegAlloc();
   virtual bool addPreEmitPass();
 };
@@ -92,6 +100,14 @@ TargetPassConfig *Cpu0TargetMachine::createPassConfig(PassManagerBase &PM) {
   return new Cpu0PassConfig(this, PM);
 } // lbd document - mark - createPassConfig
 
+void Cpu0TargetMachine::addAnalysisPasses(PassManagerBase &PM) {
+  // Add first the target-independent BasicTTI pass, then our Cpu0 pass. This
+  // thereby places the Cpu0 pass at the top of the TTI stack, so queries it
+  // does not answer fall through to the generic implementation.
+  PM.add(createBasicTargetTransformInfoPass(this));
+  PM.add(createCpu0TargetTransformInfoPass(this));
+}
+
 // Install an instruction selector pass using
 // the ISelDag to gen Cpu0 code.
 bool Cpu0PassConfig::addInstSelector() {
@@ -99,7 +115,21 @@ bool Cpu0PassConfig::addInstSelector() {
   return false;
 } // lbd document - mark - addInstSelector()
 
+bool Cpu0PassConfig::addILPOpts() {
+  // Turn small diamonds into movz/movn, using canInsertSelect for the cost.
+  if (Cpu0EarlyIfConv && getCpu0Subtarget().hasCpu032II()) {
+    addPass(&EarlyIfConverterID);
+    return true;
+  }
+  return false;
+}
+
 bool Cpu0PassConfig::addPreRegAlloc() {
+  // Shorten the live ranges of the cmp flags in $sw and drop redundant cmp
+  // while still in SSA form.
+  if (getOptLevel() != CodeGenOpt::None)
+    addPass(createCpu0OptimizeCmpPass(getCpu0TargetMachine()));
+
   // $gp is a caller-saved register.
 
   addPass(createCpu0EmitGPRestorePass(getCpu0TargetMachine()));
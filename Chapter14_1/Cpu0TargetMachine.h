@@ -46,6 +46,8 @@ namespace llvm {
     { return &FrameLowering; }
     virtual const Cpu0Subtarget   *getSubtargetImpl() const
     { return &Subtarget; }
+    virtual const InstrItineraryData *getInstrItineraryData() const
+    { return &Subtarget.getInstrItineraryData(); }
     virtual const DataLayout *getDataLayout()    const
     { return &DL;}
 
@@ -63,6 +65,9 @@ namespace llvm {
 
     // Pass Pipeline Configuration
     virtual TargetPassConfig *createPassConfig(PassManagerBase &PM);
+
+    /// \brief Register Cpu0 analysis passes with a pass manager.
+    virtual void addAnalysisPasses(PassManagerBase &PM);
   };
 
 /// Cpu0ebTargetMachine - Cpu032 big endian target machine.
@@ -24,8 +24,16 @@ SSThreshold("cpu0-ssection-threshold", cl::Hidden,
             cl::desc("Small data and bss section threshold size (default=8)"),
             cl::init(8));
 
+static cl::opt<bool> GPConstPool(
+  "cpu0-gp-const-pool",
+  cl::init(false),
+  cl::desc("Load large 32-bit constants from a .sdata constant pool through "
+           "$gp instead of building them with lui/ori."),
+  cl::Hidden);
+
 void Cpu0TargetObjectFile::Initialize(MCContext &Ctx, const TargetMachine &TM){
   TargetLoweringObjectFileELF::Initialize(Ctx, TM);
+  this->TM = &TM;
 
   SmallDataSection =
     getContext().getELFSection(".sdata", ELF::SHT_PROGBITS,
@@ -37,6 +45,12 @@ void Cpu0TargetObjectFile::Initialize(MCContext &Ctx, const TargetMachine &TM){
                                ELF::SHF_WRITE |ELF::SHF_ALLOC,
                                SectionKind::getBSS());
 
+  // Mergeable, so the linker keeps one copy of each constant no matter how
+  // many functions or modules put it in their pool.
+  SmallConst4Section =
+    getContext().getELFSection(".sdata.cst4", ELF::SHT_PROGBITS,
+                               ELF::SHF_ALLOC | ELF::SHF_MERGE,
+                               SectionKind::getMergeableConst4(), 4, "");
 }
 
 // lbd document - mark - IsInSmallSection
@@ -103,3 +117,24 @@ SelectSectionForGlobal(const GlobalValue *GV, SectionKind Kind,
   // Otherwise, we work the same as ELF.
   return TargetLoweringObjectFileELF::SelectSectionForGlobal(GV, Kind, Mang,TM);
 }
+
+/// IsConstantInSmallSection - The constant pool is only $gp relative in
+/// static code with small sections; PIC code would need a GOT load to reach
+/// it, which costs as much as lui/ori.
+bool Cpu0TargetObjectFile::
+IsConstantInSmallSection(const TargetMachine &TM) const {
+  if (!GPConstPool || TM.getRelocationModel() == Reloc::PIC_)
+    return false;
+
+  const Cpu0Subtarget &Subtarget = TM.getSubtarget<Cpu0Subtarget>();
+  return Subtarget.useSmallSection() && IsInSmallSection(4);
+}
+
+const MCSection *Cpu0TargetObjectFile::
+getSectionForConstant(SectionKind Kind) const {
+  if (Kind.isMergeableConst4() && IsConstantInSmallSection(*TM))
+    return SmallConst4Section;
+
+  // Otherwise, we work the same as ELF.
+  return TargetLoweringObjectFileELF::getSectionForConstant(Kind);
+}
@@ -17,6 +17,8 @@ namespace llvm {
   class Cpu0TargetObjectFile : public TargetLoweringObjectFileELF {
     const MCSection *SmallDataSection;
     const MCSection *SmallBSSSection;
+    const MCSection *SmallConst4Section;
+    const TargetMachine *TM;
   public:
 
     void Initialize(MCContext &Ctx, const TargetMachine &TM);
@@ -36,6 +38,14 @@ namespace llvm {
                                             const TargetMachine &TM)
                                             const override;
 
+    /// IsConstantInSmallSection - Return true if 4 byte constant pool
+    /// entries are placed into the small data section and addressed with
+    /// %gp_rel, see -cpu0-gp-const-pool. It does not need Initialize, so
+    /// Cpu0TargetLowering can ask it while setting up its actions.
+    bool IsConstantInSmallSection(const TargetMachine &TM) const;
+
+    const MCSection *getSectionForConstant(SectionKind Kind) const override;
+
     // TODO: Classify globals as cpu0 wishes.
   };
 } // end namespace llvm
@@ -0,0 +1,279 @@
+//===-- Cpu0TargetTransformInfo.cpp - Cpu0 specific TTI pass --------------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+/// \file
+/// This file implements a TargetTransformInfo analysis pass specific to the
+/// Cpu0 target machine. It uses the target's detailed information to provide
+/// more precise answers to certain TTI queries, while letting the target
+/// independent and default TTI implementations handle the rest.
+///
+/// The costs reported here are what the IR level passes (loop unrolling,
+/// inlining, constant hoisting and LSR) see, so they are kept in line with
+/// what the backend actually emits: Cpu0AnalyzeImmediate for constant
+/// materialisation and the Cpu0GenericItineraries latencies for the
+/// multiply/divide unit.
+///
+//===----------------------------------------------------------------------===//
+
+#define DEBUG_TYPE "cpu0tti"
+
+#include "Cpu0.h"
+#include "Cpu0TargetMachine.h"
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
+#include "llvm/Analysis/TargetTransformInfo.h"
+#include "llvm/IR/Instruction.h"
+#include "llvm/IR/Intrinsics.h"
+using namespace llvm;
+
+extern bool FixGlobalBaseReg;
+
+// Declare the pass initialization routine locally as target-specific passes
+// don't have a target-wide initialization entry point, and so we rely on the
+// pass constructor initialization.
+namespace llvm {
+void initializeCpu0TTIPass(PassRegistry &);
+}
+
+namespace {
+
+class Cpu0TTI : public ImmutablePass, public TargetTransformInfo {
+  const Cpu0TargetMachine *TM;
+  const Cpu0Subtarget *ST;
+  const Cpu0InstrInfo *TII;
+
+public:
+  Cpu0TTI() : ImmutablePass(ID), TM(nullptr), ST(nullptr), TII(nullptr) {
+    llvm_unreachable("This pass cannot be directly constructed");
+  }
+
+  Cpu0TTI(const Cpu0TargetMachine *TM)
+      : ImmutablePass(ID), TM(TM), ST(TM->getSubtargetImpl()),
+        TII(TM->getInstrInfo()) {
+    initializeCpu0TTIPass(*PassRegistry::getPassRegistry());
+  }
+
+  virtual void initializePass() {
+    pushTTIStack(this);
+  }
+
+  virtual void getAnalysisUsage(AnalysisUsage &AU) const {
+    TargetTransformInfo::getAnalysisUsage(AU);
+  }
+
+  /// Pass identification.
+  static char ID;
+
+  /// Provide necessary pointer adjustments for the two base classes.
+  virtual void *getAdjustedAnalysisPointer(const void *ID) {
+    if (ID == &TargetTransformInfo::ID)
+      return (TargetTransformInfo*)this;
+    return this;
+  }
+
+  /// \name Scalar TTI Implementations
+  /// @{
+  using TargetTransformInfo::getIntImmCost;
+  virtual unsigned getIntImmCost(const APInt &Imm, Type *Ty) const;
+  virtual unsigned getIntImmCost(unsigned Opcode, unsigned Idx,
+                                 const APInt &Imm, Type *Ty) const;
+  virtual unsigned getIntImmCost(Intrinsic::ID IID, unsigned Idx,
+                                 const APInt &Imm, Type *Ty) const;
+
+  virtual void getUnrollingPreferences(Loop *L,
+                                       UnrollingPreferences &UP) const;
+  /// @}
+
+  /// \name Vector TTI Implementations
+  /// @{
+  virtual unsigned getNumberOfRegisters(bool Vector) const;
+  virtual unsigned getRegisterBitWidth(bool Vector) const;
+
+  virtual unsigned getArithmeticInstrCost(unsigned Opcode, Type *Ty,
+                                  OperandValueKind Op1Info = OK_AnyValue,
+                                  OperandValueKind Op2Info = OK_AnyValue) const;
+  /// @}
+};
+
+} // end anonymous namespace
+
+INITIALIZE_AG_PASS(Cpu0TTI, TargetTransformInfo, "cpu0tti",
+                   "Cpu0 Target Transform Info", true, true, false)
+char Cpu0TTI::ID = 0;
+
+ImmutablePass *
+llvm::createCpu0TargetTransformInfoPass(const Cpu0TargetMachine *TM) {
+  return new Cpu0TTI(TM);
+}
+
+//===----------------------------------------------------------------------===//
+//
+// Cpu0 cost model.
+//
+//===----------------------------------------------------------------------===//
+
+/// getIntImmCost - Return the number of instructions Cpu0AnalyzeImmediate
+/// needs to build Imm in a register. Zero is free since it is $zero.
+unsigned Cpu0TTI::getIntImmCost(const APInt &Imm, Type *Ty) const {
+  assert(Ty->isIntegerTy());
+
+  unsigned BitSize = Ty->getPrimitiveSizeInBits();
+  if (BitSize == 0 || BitSize > 32)
+    return TargetTransformInfo::getIntImmCost(Imm, Ty);
+
+  if (Imm == 0)
+    return TCC_Free;
+
+  return Cpu0AnalyzeImmediate::getCost(Imm.getZExtValue()) * TCC_Basic;
+}
+
+/// getIntImmCost - Return TCC_Free if Imm can be encoded directly in the
+/// immediate field of the instruction selected for Opcode, so that constant
+/// hoisting leaves it alone, or the materialisation cost otherwise.
+unsigned Cpu0TTI::getIntImmCost(unsigned Opcode, unsigned Idx,
+                                const APInt &Imm, Type *Ty) const {
+  assert(Ty->isIntegerTy());
+
+  unsigned BitSize = Ty->getPrimitiveSizeInBits();
+  if (BitSize == 0 || BitSize > 32)
+    return TCC_Free;
+
+  int64_t SImm = Imm.sextOrTrunc(64).getSExtValue();
+  uint64_t ZImm = Imm.zextOrTrunc(64).getZExtValue();
+
+  switch (Opcode) {
+  default:
+    break;
+  case Instruction::GetElementPtr:
+    // Always hoist the base address of a GetElementPtr. The other indices
+    // fold into the address computation.
+    if (Idx == 0)
+      return 2 * TCC_Basic;
+    return TCC_Free;
+  case Instruction::Store:
+    // The stored value needs a register, the address offset is folded.
+    if (Idx == 0)
+      break;
+    return TCC_Free;
+  case Instruction::Add:
+    // addiu $r, $r, simm16
+    if (Idx == 1 && isInt<16>(SImm))
+      return TCC_Free;
+    break;
+  case Instruction::Sub:
+    // Selected as addiu with the negated immediate.
+    if (Idx == 1 && isInt<16>(-SImm))
+      return TCC_Free;
+    break;
+  case Instruction::And:
+  case Instruction::Or:
+  case Instruction::Xor:
+    // andi/ori/xori take a zero extended uimm16.
+    if (Idx == 1 && isUInt<16>(ZImm))
+      return TCC_Free;
+    break;
+  case Instruction::ICmp:
+    // slti/sltiu take a simm16. Cpu032I compares register against register.
+    if (Idx == 1 && ST->hasSlt() && isInt<16>(SImm))
+      return TCC_Free;
+    break;
+  case Instruction::Shl:
+  case Instruction::LShr:
+  case Instruction::AShr:
+    // shl/shr/sra encode the shift amount.
+    if (Idx == 1)
+      return TCC_Free;
+    break;
+  }
+
+  return Cpu0TTI::getIntImmCost(Imm, Ty);
+}
+
+unsigned Cpu0TTI::getIntImmCost(Intrinsic::ID IID, unsigned Idx,
+                                const APInt &Imm, Type *Ty) const {
+  // None of the intrinsics Cpu0 lowers take an immediate worth hoisting.
+  return TCC_Free;
+}
+
+/// getUnrollingPreferences - Cpu0 is single issue without a loop buffer, so
+/// unrolling mostly pays for itself by removing the compare and branch (and
+/// the branch delay slot) of each iteration. Allow partial and runtime
+/// unrolling but keep the unroll factor small to limit code growth.
+void Cpu0TTI::getUnrollingPreferences(Loop *L,
+                                      UnrollingPreferences &UP) const {
+  UP.Partial = true;
+  UP.Runtime = true;
+  UP.MaxCount = 4;
+}
+
+//===----------------------------------------------------------------------===//
+//
+// Register and arithmetic costs.
+//
+//===----------------------------------------------------------------------===//
+
+/// getNumberOfRegisters - Return the number of registers the allocator can
+/// hand out to IR values. $zero, $at, $sw, $sp, $lr and $pc are never
+/// allocatable; $gp and $fp are taken away when they are fixed.
+unsigned Cpu0TTI::getNumberOfRegisters(bool Vector) const {
+  if (Vector)
+    return 0;
+
+  unsigned NumRegs = 10;
+  // A fixed $gp is only reserved in functions that address through it (see
+  // Cpu0FunctionInfo::globalBaseRegReserved), which is not known until
+  // instruction selection. Count it as taken, so the answer may be one
+  // register short but never promises a register the function lacks.
+  if (FixGlobalBaseReg)
+    --NumRegs;
+  if (TM->Options.NoFramePointerElim)
+    --NumRegs;
+  return NumRegs;
+}
+
+unsigned Cpu0TTI::getRegisterBitWidth(bool Vector) const {
+  if (Vector)
+    return 0;
+  return 32;
+}
+
+/// getArithmeticInstrCost - Multiplication and division go through the
+/// HI/LO unit, which is much slower than the 1 cycle ALU. Report the
+/// itinerary latency plus the mflo/mfhi needed to read the result, so the
+/// vectorizer cost model, LSR and the inliner stop treating them as cheap.
+unsigned Cpu0TTI::getArithmeticInstrCost(unsigned Opcode, Type *Ty,
+                                         OperandValueKind Op1Info,
+                                         OperandValueKind Op2Info) const {
+  if (!Ty->isIntegerTy() || Ty->getPrimitiveSizeInBits() > 32)
+    return TargetTransformInfo::getArithmeticInstrCost(Opcode, Ty, Op1Info,
+                                                       Op2Info);
+
+  bool ConstDivisor = (Op2Info == TargetTransformInfo::OK_UniformConstantValue);
+
+  switch (Opcode) {
+  default:
+    break;
+  case Instruction::Mul:
+    // mul $rc, $ra, $rb
+    return TII->getOpcodeLatency(Cpu0::MUL);
+  case Instruction::SDiv:
+  case Instruction::UDiv:
+  case Instruction::SRem:
+  case Instruction::URem:
+    // A constant divisor is turned into a multiply by the magic number
+    // (mult + mfhi) followed by a couple of shifts and adds.
+    if (ConstDivisor)
+      return TII->getOpcodeLatency(Cpu0::MULT) +
+             TII->getOpcodeLatency(Cpu0::MFHI) + 3 * TCC_Basic;
+    // div/divu + mflo/mfhi
+    return TII->getOpcodeLatency(Cpu0::SDIV) +
+           TII->getOpcodeLatency(Cpu0::MFLO);
+  }
+
+  return TargetTransformInfo::getArithmeticInstrCost(Opcode, Ty, Op1Info,
+                                                     Op2Info);
+}
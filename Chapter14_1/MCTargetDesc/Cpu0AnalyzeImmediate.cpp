@@ -6,12 +6,18 @@
 // License. See LICENSE.TXT for details.
 //
 //===----------------------------------------------------------------------===//
-#include "Cpu0AnalyzeImmediate.h"
-#include "Cpu0.h"
+#define DEBUG_TYPE "cpu0-analyze-imm"
+
+#include "MCTargetDesc/Cpu0AnalyzeImmediate.h"
+#include "MCTargetDesc/Cpu0MCTargetDesc.h"
+#include "llvm/ADT/Statistic.h"
 #include "llvm/Support/MathExtras.h"
 
 using namespace llvm;
 
+STATISTIC(NumAnalyzed, "Number of immediates searched for a sequence");
+STATISTIC(NumCached,   "Number of immediate sequences found in the cache");
+
 Cpu0AnalyzeImmediate::Inst::Inst(unsigned O, unsigned I) : Opc(O), ImmOpnd(I) {}
 
 // Add I to the instruction sequences.
@@ -124,6 +130,14 @@ void Cpu0AnalyzeImmediate::GetShortestSeq(InstSeqLs &SeqLs, InstSeq &Insts) {
 const Cpu0AnalyzeImmediate::InstSeq
 &Cpu0AnalyzeImmediate::Analyze(uint64_t Imm, unsigned Size,
                                bool LastInstrIsADDiu) {
+  std::pair<uint64_t, unsigned> Key(Imm, (Size << 1) | LastInstrIsADDiu);
+  SeqCache::const_iterator I = Cache.find(Key);
+  if (I != Cache.end()) {
+    ++NumCached;
+    return I->second;
+  }
+  ++NumAnalyzed;
+
   this->Size = Size;
 
   ADDiu = Cpu0::ADDiu;
@@ -142,5 +156,12 @@ const Cpu0AnalyzeImmediate::InstSeq
   // Set Insts to the shortest instruction sequence.
   GetShortestSeq(SeqLs, Insts);
 
-  return Insts;
+  return Cache[Key] = Insts;
+}
+
+unsigned Cpu0AnalyzeImmediate::getCost(uint64_t Imm) {
+  uint32_t Imm32 = (uint32_t)Imm;
+  if (isInt<16>((int32_t)Imm32) || isUInt<16>(Imm32) || !(Imm32 & 0xffff))
+    return 1;
+  return 2;
 }
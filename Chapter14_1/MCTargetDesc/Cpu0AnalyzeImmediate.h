@@ -9,6 +9,7 @@
 #ifndef CPU0_ANALYZE_IMMEDIATE_H
 #define CPU0_ANALYZE_IMMEDIATE_H
 
+#include "llvm/ADT/DenseMap.h"
 #include "llvm/ADT/SmallVector.h"
 #include "llvm/Support/DataTypes.h"
 
@@ -24,11 +25,22 @@ namespace llvm {
 
     /// Analyze - Get an instrucion sequence to load immediate Imm. The last
     /// instruction in the sequence must be an ADDiu if LastInstrIsADDiu is
-    /// true;
+    /// true; The result is cached in this analyzer and the reference stays
+    /// valid until the next call.
     const InstSeq &Analyze(uint64_t Imm, unsigned Size, bool LastInstrIsADDiu);
+
+    /// getCost - Return the length of Analyze(Imm, 32, false) without
+    /// searching: one instruction for addiu, ori or lui alone, otherwise
+    /// two, since lui and ori build any 32 bit value.
+    static unsigned getCost(uint64_t Imm);
   private:
     typedef SmallVector<InstSeq, 5> InstSeqLs;
 
+    /// SeqCache - Shortest sequences found so far, keyed by Imm and by
+    /// Size and LastInstrIsADDiu packed together.
+    typedef DenseMap<std::pair<uint64_t, unsigned>, InstSeq> SeqCache;
+    SeqCache Cache;
+
     /// AddInstr - Add I to all instruction sequences in SeqLs.
     void AddInstr(InstSeqLs &SeqLs, const Inst &I);
 
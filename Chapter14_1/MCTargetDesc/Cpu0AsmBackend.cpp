@@ -22,6 +22,7 @@
 #include "llvm/MC/MCObjectWriter.h"
 #include "llvm/MC/MCSubtargetInfo.h"
 #include "llvm/Support/ErrorHandling.h"
+#include "llvm/Support/MathExtras.h"
 #include "llvm/Support/raw_ostream.h"
 
 using namespace llvm;
@@ -34,10 +35,14 @@ static unsigned adjustFixupValue(unsigned Kind, uint64_t Value) {
   default:
     return 0;
   case FK_GPRel_4:
+  case FK_Data_2:
   case FK_Data_4:
   case Cpu0::fixup_Cpu0_CALL16:
   case Cpu0::fixup_Cpu0_LO16:
+  case Cpu0::fixup_Cpu0_GPREL16:
   case Cpu0::fixup_Cpu0_GOT_LO16:
+    // The relocations are REL, so a folded offset is written in place as
+    // the addend.
     break;
   case Cpu0::fixup_Cpu0_PC16:
   case Cpu0::fixup_Cpu0_PC24:
@@ -52,7 +57,9 @@ static unsigned adjustFixupValue(unsigned Kind, uint64_t Value) {
   case Cpu0::fixup_Cpu0_HI16:
   case Cpu0::fixup_Cpu0_GOT_Local:
   case Cpu0::fixup_Cpu0_GOT_HI16:
-    // Get the higher 16-bits. Also add 1 if bit 15 is 1.
+    // Get the higher 16-bits. Also add 1 if bit 15 is 1, since the paired
+    // %lo is sign extended. This also carries a folded offset, sym+off,
+    // across the 64K boundary; off may be negative, the arithmetic wraps.
     Value = ((Value + 0x8000) >> 16) & 0xffff;
     break;
   }
@@ -86,6 +93,14 @@ public:
                                 unsigned DataSize, uint64_t Value,
                                 bool IsPCRel) const {
     MCFixupKind Kind = Fixup.getKind();
+
+    // Jump table entries are the (negative) distance back from the table at
+    // the end of the function. Check the signed value before
+    // adjustFixupValue cuts it to 32 bits; never truncate one that does not
+    // fit.
+    if ((unsigned)Kind == FK_Data_2 && !isInt<16>(SignExtend64<32>(Value)))
+      report_fatal_error("jump table entry out of range for a 16-bit entry");
+
     Value = adjustFixupValue((unsigned)Kind, Value);
 
     if (!Value)
@@ -102,6 +117,10 @@ public:
     case Cpu0::fixup_Cpu0_24:
       FullSize = 3;
       break;
+    case FK_Data_2:
+      // Jump table entries.
+      FullSize = 2;
+      break;
     default:
       FullSize = 4;
       break;
@@ -170,7 +189,11 @@ public:
   ///
   /// \param Inst - The instruction to test.
   bool mayNeedRelaxation(const MCInst &Inst) const {
-    return false;
+    // beq/bne to a label start in the short form and only grow if the
+    // label ends up out of range after layout.
+    unsigned Opc = Inst.getOpcode();
+    return (Opc == Cpu0::BEQ || Opc == Cpu0::BNE) &&
+           Inst.getOperand(2).isExpr();
   }
 
   /// fixupNeedsRelaxation - Target specific predicate for whether a given
@@ -179,9 +202,11 @@ public:
                             uint64_t Value,
                             const MCRelaxableFragment *DF,
                             const MCAsmLayout &Layout) const {
-    // FIXME.
-    assert(0 && "RelaxInstruction() unimplemented");
-    return false;
+    if ((unsigned)Fixup.getKind() != Cpu0::fixup_Cpu0_PC16)
+      return false;
+    // The displacement is taken from the instruction after the branch,
+    // see adjustFixupValue().
+    return !isInt<16>((int64_t)Value - 4);
   }
 
   /// RelaxInstruction - Relax the instruction in the given fragment
@@ -191,6 +216,10 @@ public:
   /// as the output.
   /// \parm Res [output] - On return, the relaxed instruction.
   void relaxInstruction(const MCInst &Inst, MCInst &Res) const {
+    // Same operands, the target now goes in the 24 bit field of a jmp.
+    Res = Inst;
+    Res.setOpcode(Inst.getOpcode() == Cpu0::BEQ ? Cpu0::BEQ_LONG
+                                                : Cpu0::BNE_LONG);
   }
 
   /// @}
@@ -201,6 +230,15 @@ public:
   ///
   /// \return - True on success.
   bool writeNopData(uint64_t Count, MCObjectWriter *OW) const {
+    // A count that is not a multiple of 4 means data (jump table entries,
+    // .byte or .half) was emitted into the text section. Fill the odd bytes
+    // with zeros first, as Mips does, so the nop words that follow land on
+    // an instruction boundary.
+    OW->WriteZeros(Count % 4);
+
+    // nop is encoded as all zero, the same in either byte order.
+    for (uint64_t i = 0, e = Count / 4; i != e; ++i)
+      OW->Write32(0);
     return true;
   }
 }; // class Cpu0AsmBackend
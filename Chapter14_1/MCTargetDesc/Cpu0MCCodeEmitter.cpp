@@ -68,6 +68,11 @@ public:
                          SmallVectorImpl<MCFixup> &Fixups,
                          const MCSubtargetInfo &STI) const override;
 
+  // EncodeLongBranch - Emit the relaxed form of an out of range beq/bne.
+  void EncodeLongBranch(const MCInst &MI, raw_ostream &OS,
+                        SmallVectorImpl<MCFixup> &Fixups,
+                        const MCSubtargetInfo &STI) const;
+
   // getBinaryCodeForInstr - TableGen'erated function for getting the
   // binary encoding for an instruction.
   uint64_t getBinaryCodeForInstr(const MCInst &MI,
@@ -133,12 +138,17 @@ EncodeInstruction(const MCInst &MI, raw_ostream &OS,
                   SmallVectorImpl<MCFixup> &Fixups,
                   const MCSubtargetInfo &STI) const
 {
+  unsigned Opcode = MI.getOpcode();
+  if (Opcode == Cpu0::BEQ_LONG || Opcode == Cpu0::BNE_LONG) {
+    EncodeLongBranch(MI, OS, Fixups, STI);
+    return;
+  }
+
   uint32_t Binary = getBinaryCodeForInstr(MI, Fixups, STI);
 
   // Check for unimplemented opcodes.
   // Unfortunately in CPU0 both NOT and SLL will come in with Binary == 0
   // so we have to special check for them.
-  unsigned Opcode = MI.getOpcode();
   if ((Opcode != Cpu0::NOP) && (Opcode != Cpu0::SHL) && !Binary)
     llvm_unreachable("unimplemented opcode in EncodeInstruction()");
 
@@ -156,6 +166,40 @@ EncodeInstruction(const MCInst &MI, raw_ostream &OS,
   EmitInstruction(Binary, Size, OS);
 }
 
+/// EncodeLongBranch - Emit BEQ_LONG/BNE_LONG as
+///   bne/beq $ra, $rb, 8
+///   nop
+///   jmp target
+/// The inverted branch skips to the instruction after the jmp, which was
+/// the delay slot of the original branch and now is the delay slot of the
+/// jmp, so it still runs on both paths.
+void Cpu0MCCodeEmitter::
+EncodeLongBranch(const MCInst &MI, raw_ostream &OS,
+                 SmallVectorImpl<MCFixup> &Fixups,
+                 const MCSubtargetInfo &STI) const {
+  MCInst Br;
+  Br.setOpcode(MI.getOpcode() == Cpu0::BEQ_LONG ? Cpu0::BNE : Cpu0::BEQ);
+  Br.addOperand(MI.getOperand(0));
+  Br.addOperand(MI.getOperand(1));
+  Br.addOperand(MCOperand::CreateImm(8));
+  EncodeInstruction(Br, OS, Fixups, STI);
+
+  MCInst Nop;
+  Nop.setOpcode(Cpu0::NOP);
+  EncodeInstruction(Nop, OS, Fixups, STI);
+
+  // The fixup of the jmp is 8 bytes into the sequence.
+  MCInst Jmp;
+  Jmp.setOpcode(Cpu0::JMP);
+  Jmp.addOperand(MI.getOperand(2));
+  SmallVector<MCFixup, 1> JmpFixups;
+  EncodeInstruction(Jmp, OS, JmpFixups, STI);
+  for (unsigned i = 0, e = JmpFixups.size(); i != e; ++i) {
+    JmpFixups[i].setOffset(JmpFixups[i].getOffset() + 8);
+    Fixups.push_back(JmpFixups[i]);
+  }
+}
+
 /// getBranch16TargetOpValue - Return binary encoding of the branch
 /// target operand. If the machine operand requires relocation,
 /// record the relocation and return zero.
@@ -243,8 +287,15 @@ getMachineOpValue(const MCInst &MI, const MCOperand &MO,
   const MCExpr *Expr = MO.getExpr();
   MCExpr::ExprKind Kind = Expr->getKind();
 
+  // A global with a folded offset comes in as sym+const. The fixup kind is
+  // picked from the symbol; the fixup keeps the whole expression so the
+  // constant ends up in the relocation addend.
   if (Kind == MCExpr::Binary) {
-    Expr = static_cast<const MCBinaryExpr*>(Expr)->getLHS();
+    const MCBinaryExpr *BE = static_cast<const MCBinaryExpr*>(Expr);
+    assert(BE->getOpcode() == MCBinaryExpr::Add &&
+           isa<MCConstantExpr>(BE->getRHS()) &&
+           "Binary expression must be sym+const.");
+    Expr = BE->getLHS();
     Kind = Expr->getKind();
   }
 
@@ -0,0 +1,47 @@
+#!/usr/bin/env bash
+
+if [ $# == "0" ]; then
+  echo "useage: bash bench-analyzeimm.sh cpu_type [repeat]"
+  echo "  cpu_type: cpu032I or cpu032II"
+  echo "  repeat: copies of the ch_immbench.s constants to assemble (default 100)"
+  echo "for example:"
+  echo "  bash bench-analyzeimm.sh cpu032II 100"
+  exit 1;
+fi
+if [ $1 != cpu032I ] && [ $1 != cpu032II ]; then
+  echo "1st argument is cpu032I or cpu032II"
+  exit 1
+fi
+
+OS=`uname -s`
+echo "OS =" ${OS}
+
+if [ "$OS" == "Linux" ]; then
+  TOOLDIR=/usr/local/llvm/test/cmake_debug_build/bin
+else
+  TOOLDIR=~/llvm/test/cmake_debug_build/Debug/bin
+fi
+
+CPU=$1
+echo "CPU =" "${CPU}"
+
+REPEAT=100
+if [ "$2" != "" ]; then
+  REPEAT=$2
+fi
+echo "repeat =" "${REPEAT}"
+
+# Measure how fast the li expansion analyzes immediates. The first copy of
+# the constants is searched by Cpu0AnalyzeImmediate::Analyze, every later
+# copy is served from its cache. -stats reports both counts, and time how
+# long the assembly took.
+cp ch_immbench.s immbench.s
+for (( i = 1; i < ${REPEAT}; i++ )); do
+  grep "^	li" ch_immbench.s >> immbench.s
+done
+echo "immediates =" `grep -c "^	li" immbench.s`
+
+time ${TOOLDIR}/llvm-mc -arch=cpu0 -mcpu=${CPU} -filetype=obj -stats \
+immbench.s -o immbench.cpu0.o
+
+rm -f immbench.s immbench.cpu0.o
@@ -0,0 +1,334 @@
+# llvm-mc -arch=cpu0 -mcpu=cpu032II -filetype=obj -stats ch_immbench.s -o ch_immbench.cpu0.o
+# bash bench-analyzeimm.sh cpu032II 100
+#
+# Micro-benchmark input for Cpu0AnalyzeImmediate. Each li is expanded
+# through Cpu0AnalyzeImmediate::Analyze. The constants are those of
+# table driven code: the CRC-32 table and the AES S-box packed into words.
+
+	.text
+	.globl	crc32_table
+crc32_table:
+	li	$2, 0x00000000
+	li	$2, 0x77073096
+	li	$2, 0xee0e612c
+	li	$2, 0x990951ba
+	li	$2, 0x076dc419
+	li	$2, 0x706af48f
+	li	$2, 0xe963a535
+	li	$2, 0x9e6495a3
+	li	$2, 0x0edb8832
+	li	$2, 0x79dcb8a4
+	li	$2, 0xe0d5e91e
+	li	$2, 0x97d2d988
+	li	$2, 0x09b64c2b
+	li	$2, 0x7eb17cbd
+	li	$2, 0xe7b82d07
+	li	$2, 0x90bf1d91
+	li	$2, 0x1db71064
+	li	$2, 0x6ab020f2
+	li	$2, 0xf3b97148
+	li	$2, 0x84be41de
+	li	$2, 0x1adad47d
+	li	$2, 0x6ddde4eb
+	li	$2, 0xf4d4b551
+	li	$2, 0x83d385c7
+	li	$2, 0x136c9856
+	li	$2, 0x646ba8c0
+	li	$2, 0xfd62f97a
+	li	$2, 0x8a65c9ec
+	li	$2, 0x14015c4f
+	li	$2, 0x63066cd9
+	li	$2, 0xfa0f3d63
+	li	$2, 0x8d080df5
+	li	$2, 0x3b6e20c8
+	li	$2, 0x4c69105e
+	li	$2, 0xd56041e4
+	li	$2, 0xa2677172
+	li	$2, 0x3c03e4d1
+	li	$2, 0x4b04d447
+	li	$2, 0xd20d85fd
+	li	$2, 0xa50ab56b
+	li	$2, 0x35b5a8fa
+	li	$2, 0x42b2986c
+	li	$2, 0xdbbbc9d6
+	li	$2, 0xacbcf940
+	li	$2, 0x32d86ce3
+	li	$2, 0x45df5c75
+	li	$2, 0xdcd60dcf
+	li	$2, 0xabd13d59
+	li	$2, 0x26d930ac
+	li	$2, 0x51de003a
+	li	$2, 0xc8d75180
+	li	$2, 0xbfd06116
+	li	$2, 0x21b4f4b5
+	li	$2, 0x56b3c423
+	li	$2, 0xcfba9599
+	li	$2, 0xb8bda50f
+	li	$2, 0x2802b89e
+	li	$2, 0x5f058808
+	li	$2, 0xc60cd9b2
+	li	$2, 0xb10be924
+	li	$2, 0x2f6f7c87
+	li	$2, 0x58684c11
+	li	$2, 0xc1611dab
+	li	$2, 0xb6662d3d
+	li	$2, 0x76dc4190
+	li	$2, 0x01db7106
+	li	$2, 0x98d220bc
+	li	$2, 0xefd5102a
+	li	$2, 0x71b18589
+	li	$2, 0x06b6b51f
+	li	$2, 0x9fbfe4a5
+	li	$2, 0xe8b8d433
+	li	$2, 0x7807c9a2
+	li	$2, 0x0f00f934
+	li	$2, 0x9609a88e
+	li	$2, 0xe10e9818
+	li	$2, 0x7f6a0dbb
+	li	$2, 0x086d3d2d
+	li	$2, 0x91646c97
+	li	$2, 0xe6635c01
+	li	$2, 0x6b6b51f4
+	li	$2, 0x1c6c6162
+	li	$2, 0x856530d8
+	li	$2, 0xf262004e
+	li	$2, 0x6c0695ed
+	li	$2, 0x1b01a57b
+	li	$2, 0x8208f4c1
+	li	$2, 0xf50fc457
+	li	$2, 0x65b0d9c6
+	li	$2, 0x12b7e950
+	li	$2, 0x8bbeb8ea
+	li	$2, 0xfcb9887c
+	li	$2, 0x62dd1ddf
+	li	$2, 0x15da2d49
+	li	$2, 0x8cd37cf3
+	li	$2, 0xfbd44c65
+	li	$2, 0x4db26158
+	li	$2, 0x3ab551ce
+	li	$2, 0xa3bc0074
+	li	$2, 0xd4bb30e2
+	li	$2, 0x4adfa541
+	li	$2, 0x3dd895d7
+	li	$2, 0xa4d1c46d
+	li	$2, 0xd3d6f4fb
+	li	$2, 0x4369e96a
+	li	$2, 0x346ed9fc
+	li	$2, 0xad678846
+	li	$2, 0xda60b8d0
+	li	$2, 0x44042d73
+	li	$2, 0x33031de5
+	li	$2, 0xaa0a4c5f
+	li	$2, 0xdd0d7cc9
+	li	$2, 0x5005713c
+	li	$2, 0x270241aa
+	li	$2, 0xbe0b1010
+	li	$2, 0xc90c2086
+	li	$2, 0x5768b525
+	li	$2, 0x206f85b3
+	li	$2, 0xb966d409
+	li	$2, 0xce61e49f
+	li	$2, 0x5edef90e
+	li	$2, 0x29d9c998
+	li	$2, 0xb0d09822
+	li	$2, 0xc7d7a8b4
+	li	$2, 0x59b33d17
+	li	$2, 0x2eb40d81
+	li	$2, 0xb7bd5c3b
+	li	$2, 0xc0ba6cad
+	li	$2, 0xedb88320
+	li	$2, 0x9abfb3b6
+	li	$2, 0x03b6e20c
+	li	$2, 0x74b1d29a
+	li	$2, 0xead54739
+	li	$2, 0x9dd277af
+	li	$2, 0x04db2615
+	li	$2, 0x73dc1683
+	li	$2, 0xe3630b12
+	li	$2, 0x94643b84
+	li	$2, 0x0d6d6a3e
+	li	$2, 0x7a6a5aa8
+	li	$2, 0xe40ecf0b
+	li	$2, 0x9309ff9d
+	li	$2, 0x0a00ae27
+	li	$2, 0x7d079eb1
+	li	$2, 0xf00f9344
+	li	$2, 0x8708a3d2
+	li	$2, 0x1e01f268
+	li	$2, 0x6906c2fe
+	li	$2, 0xf762575d
+	li	$2, 0x806567cb
+	li	$2, 0x196c3671
+	li	$2, 0x6e6b06e7
+	li	$2, 0xfed41b76
+	li	$2, 0x89d32be0
+	li	$2, 0x10da7a5a
+	li	$2, 0x67dd4acc
+	li	$2, 0xf9b9df6f
+	li	$2, 0x8ebeeff9
+	li	$2, 0x17b7be43
+	li	$2, 0x60b08ed5
+	li	$2, 0xd6d6a3e8
+	li	$2, 0xa1d1937e
+	li	$2, 0x38d8c2c4
+	li	$2, 0x4fdff252
+	li	$2, 0xd1bb67f1
+	li	$2, 0xa6bc5767
+	li	$2, 0x3fb506dd
+	li	$2, 0x48b2364b
+	li	$2, 0xd80d2bda
+	li	$2, 0xaf0a1b4c
+	li	$2, 0x36034af6
+	li	$2, 0x41047a60
+	li	$2, 0xdf60efc3
+	li	$2, 0xa867df55
+	li	$2, 0x316e8eef
+	li	$2, 0x4669be79
+	li	$2, 0xcb61b38c
+	li	$2, 0xbc66831a
+	li	$2, 0x256fd2a0
+	li	$2, 0x5268e236
+	li	$2, 0xcc0c7795
+	li	$2, 0xbb0b4703
+	li	$2, 0x220216b9
+	li	$2, 0x5505262f
+	li	$2, 0xc5ba3bbe
+	li	$2, 0xb2bd0b28
+	li	$2, 0x2bb45a92
+	li	$2, 0x5cb36a04
+	li	$2, 0xc2d7ffa7
+	li	$2, 0xb5d0cf31
+	li	$2, 0x2cd99e8b
+	li	$2, 0x5bdeae1d
+	li	$2, 0x9b64c2b0
+	li	$2, 0xec63f226
+	li	$2, 0x756aa39c
+	li	$2, 0x026d930a
+	li	$2, 0x9c0906a9
+	li	$2, 0xeb0e363f
+	li	$2, 0x72076785
+	li	$2, 0x05005713
+	li	$2, 0x95bf4a82
+	li	$2, 0xe2b87a14
+	li	$2, 0x7bb12bae
+	li	$2, 0x0cb61b38
+	li	$2, 0x92d28e9b
+	li	$2, 0xe5d5be0d
+	li	$2, 0x7cdcefb7
+	li	$2, 0x0bdbdf21
+	li	$2, 0x86d3d2d4
+	li	$2, 0xf1d4e242
+	li	$2, 0x68ddb3f8
+	li	$2, 0x1fda836e
+	li	$2, 0x81be16cd
+	li	$2, 0xf6b9265b
+	li	$2, 0x6fb077e1
+	li	$2, 0x18b74777
+	li	$2, 0x88085ae6
+	li	$2, 0xff0f6a70
+	li	$2, 0x66063bca
+	li	$2, 0x11010b5c
+	li	$2, 0x8f659eff
+	li	$2, 0xf862ae69
+	li	$2, 0x616bffd3
+	li	$2, 0x166ccf45
+	li	$2, 0xa00ae278
+	li	$2, 0xd70dd2ee
+	li	$2, 0x4e048354
+	li	$2, 0x3903b3c2
+	li	$2, 0xa7672661
+	li	$2, 0xd06016f7
+	li	$2, 0x4969474d
+	li	$2, 0x3e6e77db
+	li	$2, 0xaed16a4a
+	li	$2, 0xd9d65adc
+	li	$2, 0x40df0b66
+	li	$2, 0x37d83bf0
+	li	$2, 0xa9bcae53
+	li	$2, 0xdebb9ec5
+	li	$2, 0x47b2cf7f
+	li	$2, 0x30b5ffe9
+	li	$2, 0xbdbdf21c
+	li	$2, 0xcabac28a
+	li	$2, 0x53b39330
+	li	$2, 0x24b4a3a6
+	li	$2, 0xbad03605
+	li	$2, 0xcdd70693
+	li	$2, 0x54de5729
+	li	$2, 0x23d967bf
+	li	$2, 0xb3667a2e
+	li	$2, 0xc4614ab8
+	li	$2, 0x5d681b02
+	li	$2, 0x2a6f2b94
+	li	$2, 0xb40bbe37
+	li	$2, 0xc30c8ea1
+	li	$2, 0x5a05df1b
+	li	$2, 0x2d02ef8d
+
+	.globl	aes_sbox
+aes_sbox:
+	li	$3, 0x637c777b
+	li	$3, 0xf26b6fc5
+	li	$3, 0x3001672b
+	li	$3, 0xfed7ab76
+	li	$3, 0xca82c97d
+	li	$3, 0xfa5947f0
+	li	$3, 0xadd4a2af
+	li	$3, 0x9ca472c0
+	li	$3, 0xb7fd9326
+	li	$3, 0x363ff7cc
+	li	$3, 0x34a5e5f1
+	li	$3, 0x71d83115
+	li	$3, 0x04c723c3
+	li	$3, 0x1896059a
+	li	$3, 0x071280e2
+	li	$3, 0xeb27b275
+	li	$3, 0x09832c1a
+	li	$3, 0x1b6e5aa0
+	li	$3, 0x523bd6b3
+	li	$3, 0x29e32f84
+	li	$3, 0x53d100ed
+	li	$3, 0x20fcb15b
+	li	$3, 0x6acbbe39
+	li	$3, 0x4a4c58cf
+	li	$3, 0xd0efaafb
+	li	$3, 0x434d3385
+	li	$3, 0x45f9027f
+	li	$3, 0x503c9fa8
+	li	$3, 0x51a3408f
+	li	$3, 0x929d38f5
+	li	$3, 0xbcb6da21
+	li	$3, 0x10fff3d2
+	li	$3, 0xcd0c13ec
+	li	$3, 0x5f974417
+	li	$3, 0xc4a77e3d
+	li	$3, 0x645d1973
+	li	$3, 0x60814fdc
+	li	$3, 0x222a9088
+	li	$3, 0x46eeb814
+	li	$3, 0xde5e0bdb
+	li	$3, 0xe0323a0a
+	li	$3, 0x4906245c
+	li	$3, 0xc2d3ac62
+	li	$3, 0x9195e479
+	li	$3, 0xe7c8376d
+	li	$3, 0x8dd54ea9
+	li	$3, 0x6c56f4ea
+	li	$3, 0x657aae08
+	li	$3, 0xba78252e
+	li	$3, 0x1ca6b4c6
+	li	$3, 0xe8dd741f
+	li	$3, 0x4bbd8b8a
+	li	$3, 0x703eb566
+	li	$3, 0x4803f60e
+	li	$3, 0x613557b9
+	li	$3, 0x86c11d9e
+	li	$3, 0xe1f89811
+	li	$3, 0x69d98e94
+	li	$3, 0x9b1e87e9
+	li	$3, 0xce5528df
+	li	$3, 0x8ca1890d
+	li	$3, 0xbfe64268
+	li	$3, 0x41992d0f
+	li	$3, 0xb054bb16
+	ret	$lr
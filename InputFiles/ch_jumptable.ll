@@ -0,0 +1,57 @@
+; /Users/Jonathan/llvm/test/cmake_debug_build/bin/Debug/llc -march=cpu0 -mcpu=cpu032II -relocation-model=static -filetype=obj ch_jumptable.ll -o ch_jumptable.cpu0.o
+; /Users/Jonathan/llvm/test/cmake_debug_build/bin/Debug/llvm-objdump -d ch_jumptable.cpu0.o
+
+; The switch in @jumptable is lowered to a jump table of 16-bit entries,
+; the negative distance of each case block back to the table emitted after
+; the function. The beq on %b is relaxable, so the assembler cannot fold the
+; entries while it lays out the section and resolves them as FK_Data_2
+; fixups. Five entries leave the table 2 bytes short of a word; @next must
+; still start word aligned.
+
+; /// start
+define i32 @jumptable(i32 %a, i32 %b) nounwind {
+entry:
+  %cmp = icmp eq i32 %b, 0
+  br i1 %cmp, label %zero, label %dispatch
+
+zero:
+  ret i32 -1
+
+dispatch:
+  switch i32 %a, label %default [
+    i32 0, label %case0
+    i32 1, label %case1
+    i32 2, label %case2
+    i32 3, label %case3
+    i32 4, label %case4
+  ]
+
+case0:
+  %r0 = add i32 %b, 3
+  ret i32 %r0
+
+case1:
+  %r1 = mul i32 %b, %b
+  ret i32 %r1
+
+case2:
+  %r2 = sub i32 %b, 7
+  ret i32 %r2
+
+case3:
+  %r3 = xor i32 %b, 5
+  ret i32 %r3
+
+case4:
+  %r4 = shl i32 %b, 2
+  ret i32 %r4
+
+default:
+  ret i32 0
+}
+
+define i32 @next(i32 %a) nounwind {
+entry:
+  %r = add i32 %a, 1
+  ret i32 %r
+}